@@ -0,0 +1,109 @@
+#include "helang.h"
+#include "cmdline.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+//compile throughput of helang::Session,every thread compiles the same source to object files
+//in a session of its own for a fixed time,the compiles per second are reported for 1,2,4...
+//threads up to the number given
+
+//a source with n functions,each one calls the one before so none of them is dead
+static string GenerateSource(u32 n) {
+	string source = "ccnd fn print_i32(i32 n);\n";
+	for (u32 i = 0; i < n; i++) {
+		string name = "f" + to_string(i);
+		string callee = i == 0 ? "" : "f" + to_string(i - 1);
+		source += "fn " + name + "(i32 n, i32 h) -> i32 {\n";
+		source += "    mut i32 r = h;\n";
+		source += "    if (n != 0) {\n";
+		source += "        i32 a = h * 31 + n * n;\n";
+		source += "        i32 b = a / 7 + a / 13;\n";
+		source += "        r = " + name + "(n - 1, a * 17 + b * 5 + h / 3);\n";
+		if (!callee.empty()) {
+			source += "        r = r + " + callee + "(n - 1, b);\n";
+		}
+		source += "    }\n";
+		source += "    r\n";
+		source += "}\n";
+	}
+	source += "fn main() -> i32 {\n";
+	source += "    print_i32(f" + to_string(n - 1) + "(10, 1));\n";
+	source += "    0\n";
+	source += "}\n";
+	return source;
+}
+
+int main(int argc, const char** argvs) {
+	ParameterTable paramTable[] = {
+		ParameterTable("help",  "print a helper message",nullptr,print_help_message,false,{"-H","-h","--help"}),
+		ParameterTable("functions", "number of functions in the compiled source","50",nullptr,true,{"-f","--functions"}),
+		ParameterTable("threads", "max number of compile threads,0 for one per hardware thread","0",nullptr,true,{"-t","--threads"}),
+		ParameterTable("seconds", "time every thread count is measured for","3",nullptr,true,{"-s","--seconds"}),
+		ParameterTable("cpu", "target cpu,native for the host cpu","generic",nullptr,true,{"-mcpu"}),
+	};
+	ParamParser parser(argc - 1, argvs + 1, he_countof(paramTable), paramTable);
+	u32 functions = max(parser.Require<u32>("functions"), 1u);
+	u32 max_threads = parser.Require<u32>("threads");
+	if (max_threads == 0) {
+		max_threads = max(thread::hardware_concurrency(), 1u);
+	}
+	u32 seconds = max(parser.Require<u32>("seconds"), 1u);
+	helang::Options options;
+	options.cpu = parser.Require<string>("cpu");
+
+	string source = GenerateSource(functions);
+	//compile once up front so a broken source or target fails before the measurement
+	{
+		helang::Session session(options);
+		if (auto v = session.CompileObject("bench.he", source); !v.has_value()) {
+			printf("helang: %s", session.Log().c_str());
+			return -1;
+		}
+		else {
+			printf("helang: %u functions,%zu lines,%zu byte object\n", functions,
+				(size_t)count(source.begin(), source.end(), '\n'), v->size());
+		}
+	}
+
+	printf("%8s %12s %12s %10s\n", "threads", "compiles", "compiles/s", "speedup");
+	double base = 0;
+	for (u32 threads = 1;; threads = min(threads * 2, max_threads)) {
+		atomic<u64> compiles = 0;
+		atomic<bool> failed = false;
+		auto deadline = chrono::steady_clock::now() + chrono::seconds(seconds);
+		auto start = chrono::steady_clock::now();
+		vector<thread> workers;
+		for (u32 i = 0; i < threads; i++) {
+			workers.emplace_back([&]() {
+				helang::Session session(options);
+				while (chrono::steady_clock::now() < deadline) {
+					if (!session.CompileObject("bench.he", source).has_value()) {
+						failed = true;
+						return;
+					}
+					compiles++;
+				}
+			});
+		}
+		for (auto& w : workers) {
+			w.join();
+		}
+		if (failed) {
+			printf("helang: a compilation failed with %u threads\n", threads);
+			return -1;
+		}
+		double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		double rate = compiles / elapsed;
+		if (threads == 1) {
+			base = rate;
+		}
+		printf("%8u %12llu %12.1f %9.2fx\n", threads, (unsigned long long)compiles.load(), rate, rate / base);
+		fflush(stdout);
+		if (threads == max_threads) {
+			break;
+		}
+	}
+	return 0;
+}
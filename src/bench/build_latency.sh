@@ -0,0 +1,37 @@
+#!/bin/sh
+# end-to-end build latency of the in-process helang driver against the two-process flow,
+# helang-c writing an object and the c compiler compiling the runtime and linking
+# usage: build_latency.sh <build dir> <file.he> [runs]
+set -e
+BUILD=$1
+INPUT=$2
+RUNS=${3:-20}
+TEMPLATE=$(dirname "$0")/../../template
+CC=${CC:-cc}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+two_process() {
+	"$BUILD/helang-c" -c "$INPUT" -o "$OUT/out.o" >/dev/null
+	"$CC" -no-pie "$OUT/out.o" "$TEMPLATE/io.c" "$TEMPLATE/main.c" "$TEMPLATE/cpu.c" -o "$OUT/two"
+	rm -f "$OUT/out.o"
+}
+
+in_process() {
+	"$BUILD/helang" -c "$INPUT" -o "$OUT/one" >/dev/null
+}
+
+# microseconds per build with the given function
+measure() {
+	start=$(date +%s%N)
+	i=0
+	while [ $i -lt "$RUNS" ]; do
+		$1
+		i=$((i + 1))
+	done
+	end=$(date +%s%N)
+	echo $(((end - start) / 1000 / RUNS))
+}
+
+echo "helang-c + $CC: $(measure two_process) us per build"
+echo "helang:        $(measure in_process) us per build"
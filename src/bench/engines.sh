@@ -0,0 +1,25 @@
+#!/bin/sh
+# run time of examples under helang-c --run with every --engine,the outputs must agree
+# usage: engines.sh <build dir> [example.he ...]
+set -e
+BUILD=$(cd "$1" && pwd)
+shift
+EXAMPLE=$(cd "$(dirname "$0")/../../example" && pwd)
+[ $# -gt 0 ] || set -- "$EXAMPLE/tailcall.he" "$EXAMPLE/arith.he" "$EXAMPLE/branchy.he"
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+printf "%-14s %8s %8s %8s\n" example jit interp tiered
+for input in "$@"; do
+	line=$(printf "%-14s" "$(basename "$input")")
+	for engine in jit interp tiered; do
+		start=$(date +%s%N)
+		# the exit code is the value of main
+		"$BUILD/helang-c" -c "$input" --run --engine $engine -p "$BUILD" > "$OUT/$engine.out" || true
+		end=$(date +%s%N)
+		line="$line $(printf "%6dms" $(( (end - start) / 1000000 )))"
+	done
+	echo "$line"
+	cmp "$OUT/jit.out" "$OUT/interp.out"
+	cmp "$OUT/jit.out" "$OUT/tiered.out"
+done
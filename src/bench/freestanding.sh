@@ -0,0 +1,64 @@
+#!/bin/sh
+# exec-to-exit latency and size of a program built against libc and with --freestanding
+# the time of a run includes the fork and exec of the shell,which both builds pay
+# usage: freestanding.sh <build dir> [program.he] [runs]
+set -e
+BUILD=$(cd "$1" && pwd)
+SOURCE=${2:-$(dirname "$0")/../../example/hello.he}
+RUNS=${3:-2000}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+"$BUILD/helang" -c "$SOURCE" -o "$OUT/libc" > /dev/null
+"$BUILD/helang" -c "$SOURCE" -o "$OUT/freestanding" --freestanding > /dev/null
+
+for kind in libc freestanding; do
+	start=$(date +%s%N)
+	i=0
+	while [ $i -lt "$RUNS" ]; do
+		"$OUT/$kind" > /dev/null
+		i=$((i + 1))
+	done
+	end=$(date +%s%N)
+	strip -o "$OUT/$kind.stripped" "$OUT/$kind"
+	echo "$kind : $(( (end - start) / RUNS / 1000 )) us per run,$(wc -c < "$OUT/$kind") bytes,$(wc -c < "$OUT/$kind.stripped") stripped"
+done
+
+# the multiversion resolvers are module constructors,both builds must run them with the level
+# HELANG_CPU_LEVEL caps,__he_cpu_level is wrapped to print what the resolver gets
+cat > "$OUT/mv.he" <<'HE'
+ccnd fn print_i32(i32 n);
+multiversion fn next(i32 n) -> i32 {
+    n + 1
+}
+fn main() -> i32 {
+    print_i32(next(1));
+    0
+}
+HE
+cat > "$OUT/probe.c" <<'C'
+int __real___he_cpu_level();
+void print_i32(int n);
+int __wrap___he_cpu_level(){
+    int level = __real___he_cpu_level();
+    print_i32(-level);
+    return level;
+}
+C
+"$BUILD/helang-c" -c "$OUT/mv.he" -o "$OUT/mv.o" -p "$BUILD" --runtime none > /dev/null
+cc -c -O2 -fno-pic -fno-stack-protector -o "$OUT/probe.o" "$OUT/probe.c"
+cc -no-pie -Wl,--wrap=__he_cpu_level -o "$OUT/mv-libc" "$OUT/mv.o" "$OUT/probe.o" "$BUILD/libhelang_rt.a"
+cc -no-pie -static -nostdlib -Wl,--wrap=__he_cpu_level -o "$OUT/mv-freestanding" "$OUT/mv.o" "$OUT/probe.o" \
+	"$BUILD/libhelang_rt_freestanding.a" -lgcc
+host=$("$OUT/mv-libc" | sed -n 's/^saint he says: -\([0-9]\)!$/\1/p')
+for cap in 1 2 3 4; do
+	want=$(( cap < host ? cap : host ))
+	for kind in libc freestanding; do
+		got=$(HELANG_CPU_LEVEL=$cap "$OUT/mv-$kind" | sed -n 's/^saint he says: -\([0-9]\)!$/\1/p')
+		if [ "$got" != "$want" ]; then
+			echo "$kind : HELANG_CPU_LEVEL=$cap resolves level ${got:-none},expect $want"
+			exit 1
+		fi
+	done
+done
+echo "multiversion : both builds resolve every HELANG_CPU_LEVEL up to the host level $host"
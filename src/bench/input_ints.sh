@@ -0,0 +1,83 @@
+#!/bin/sh
+# integers per second of input_i32 with the block reading runtime of libhelang_rt.a and with the
+# scanf one it replaced,the same object of a helang loop summing the input is linked against both,
+# input_i32_n is timed from c on the same file
+# usage: input_ints.sh <build dir> [integers]
+set -e
+BUILD=$(cd "$1" && pwd)
+INTS=${2:-10000000}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+awk -v n="$INTS" 'BEGIN { srand(1); for (i = 0; i < n; i++) print int(rand() * 4294967296) - 2147483648 }' > "$OUT/ints.txt"
+echo "input : $(( $(wc -c < "$OUT/ints.txt") / 1024 )) KiB,$INTS integers"
+
+cat > "$OUT/sum.he" <<HE
+ccnd fn print_i32(i32 a);
+ccnd fn input_i32() -> i32;
+fn sum(i32 n, i32 acc) -> i32 {
+    mut i32 r = acc;
+    if (n != 0) {
+        r = sum(n - 1, acc + input_i32());
+    }
+    r
+}
+fn main() -> i32 {
+    print_i32(sum($INTS, 0));
+    0
+}
+HE
+
+# input_i32,print_i32 and main of template/io.c and template/main.c before the block reading runtime
+cat > "$OUT/scanf_rt.c" <<'C'
+#include <stdio.h>
+extern int __he_entry_main();
+void print_i32(int n){
+    printf("saint he says: %d!\n", n);
+}
+int input_i32(){
+    int num;
+    printf("input a i32 number:");
+    scanf("%d",&num);
+    return num;
+}
+int main(){
+    int num = __he_entry_main();
+    printf("so cool!helang exits and returns %d",num);
+}
+C
+
+cat > "$OUT/batch.c" <<'C'
+#include <stdint.h>
+void print_i32(int n);
+int64_t input_i32_n(int32_t* values, int64_t count);
+int main(){
+    static int32_t v[4096];
+    uint32_t sum = 0;
+    int64_t n;
+    while((n = input_i32_n(v, 4096)) > 0){
+        for(int64_t i = 0; i < n; i++){
+            sum += (uint32_t)v[i];
+        }
+    }
+    print_i32((int32_t)sum);
+    return 0;
+}
+C
+
+"$BUILD/helang-c" -c "$OUT/sum.he" -o "$OUT/sum.o" -p "$BUILD" --runtime none > /dev/null
+cc -O2 -no-pie -o "$OUT/scanf" "$OUT/sum.o" "$OUT/scanf_rt.c"
+cc -O2 -no-pie -o "$OUT/buffered" "$OUT/sum.o" "$BUILD/libhelang_rt.a"
+cc -O2 -no-pie -o "$OUT/input_i32_n" "$OUT/batch.c" "$BUILD/libhelang_rt.a"
+
+for kind in scanf buffered input_i32_n; do
+	start=$(date +%s%N)
+	"$OUT/$kind" < "$OUT/ints.txt" > "$OUT/$kind.out"
+	end=$(date +%s%N)
+	ms=$(( (end - start) / 1000000 ))
+	echo "$kind : $ms ms,$(( INTS * 1000 / (ms > 0 ? ms : 1) )) integers per second"
+	# the sum,after the prompts of the scanf runtime
+	grep -o "saint he says: [-0-9]*!" "$OUT/$kind.out" > "$OUT/$kind.sum"
+done
+cmp "$OUT/scanf.sum" "$OUT/buffered.sum"
+cmp "$OUT/scanf.sum" "$OUT/input_i32_n.sum"
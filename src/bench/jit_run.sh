@@ -0,0 +1,71 @@
+#!/bin/sh
+# end-to-end time of helang-c --run against compiling,linking and running,and of the eager and
+# lazy jit on a program of many files of which main reaches one chain of functions
+# every time is the whole process,llvm startup included
+# usage: jit_run.sh <build dir> [runs]
+set -e
+BUILD=$(cd "$1" && pwd)
+RUNS=${2:-20}
+CC=${CC:-cc}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+# helang-c writes the interface of hello.he next to it
+cp "$(dirname "$0")/../../example/hello.he" "$OUT/hello.he"
+
+# milliseconds per run of the given command
+measure() {
+	start=$(date +%s%N)
+	i=0
+	while [ $i -lt "$RUNS" ]; do
+		"$@" > /dev/null
+		i=$((i + 1))
+	done
+	end=$(date +%s%N)
+	echo $(( (end - start) / 1000000 / RUNS ))
+}
+
+compile_and_run() {
+	"$BUILD/helang-c" -c "$OUT/hello.he" -o "$OUT/hello.o" -p "$BUILD"
+	"$CC" -no-pie "$OUT/hello.o" "$BUILD/libhelang_rt.a" -o "$OUT/hello"
+	"$OUT/hello"
+}
+
+echo "hello.he"
+echo "  helang-c -c,$CC,run : $(measure compile_and_run) ms"
+echo "  --run               : $(measure "$BUILD/helang-c" -c "$OUT/hello.he" --run -p "$BUILD") ms"
+echo "  --run --jit-lazy    : $(measure "$BUILD/helang-c" -c "$OUT/hello.he" --run --jit-lazy -p "$BUILD") ms"
+echo "  helang-c -h         : $(measure "$BUILD/helang-c" -h) ms"
+
+# 16 files of 150 functions,main only reaches the chain of file 0
+inputs="$OUT/main.he"
+{
+	echo "ccnd fn print_i32(i32 a);"
+	echo "ccnd fn f0g0(i32 x) -> i32;"
+	echo "fn main() -> i32 {"
+	echo "    print_i32(f0g0(1));"
+	echo "    0"
+	echo "}"
+} > "$OUT/main.he"
+f=0
+while [ $f -lt 16 ]; do
+	k=0
+	while [ $k -lt 150 ]; do
+		echo "fn f${f}g$k(i32 x) -> i32 {"
+		echo "    i32 a = x * 3 + $k;"
+		echo "    i32 b = a / 7 + a * 5;"
+		if [ $k -lt 149 ]; then
+			echo "    f${f}g$((k + 1))(b)"
+		else
+			echo "    b"
+		fi
+		echo "}"
+		k=$((k + 1))
+	done > "$OUT/f$f.he"
+	inputs="$inputs;$OUT/f$f.he"
+	f=$((f + 1))
+done
+
+echo "17 files,2400 functions,a chain of 150 reached"
+echo "  --run                          : $(measure "$BUILD/helang-c" -c "$inputs" --run -p "$BUILD") ms"
+echo "  --run --jit-lazy               : $(measure "$BUILD/helang-c" -c "$inputs" --run --jit-lazy -p "$BUILD") ms"
+echo "  --run --jit-lazy --jit-threads 2 : $(measure "$BUILD/helang-c" -c "$inputs" --run --jit-lazy --jit-threads 2 -p "$BUILD") ms"
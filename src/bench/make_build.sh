@@ -0,0 +1,57 @@
+#!/bin/sh
+# build of 1000 files under make -j,50 programs of 20 files each built by one helang each
+# with the jobserver the helang processes share the job slots of make,without it every one
+# compiles its files on one thread per core
+# usage: make_build.sh <build dir> [make jobs] [programs] [files per program]
+set -e
+BUILD=$(cd "$1" && pwd)
+JOBS=${2:-$(nproc)}
+PROGRAMS=${3:-50}
+FILES=${4:-20}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+p=0
+while [ $p -lt "$PROGRAMS" ]; do
+	mkdir "$OUT/p$p"
+	main="ccnd fn print_i32(i32 a);"
+	f=1
+	while [ $f -lt "$FILES" ]; do
+		{
+			echo "fn g$f(i32 x) -> i32 {"
+			k=0
+			while [ $k -lt 50 ]; do
+				echo "    i32 v$k = x * $k + $f;"
+				k=$((k + 1))
+			done
+			echo "    v49"
+			echo "}"
+		} > "$OUT/p$p/f$f.he"
+		main="$main
+ccnd fn g$f(i32 x) -> i32;"
+		f=$((f + 1))
+	done
+	printf '%s\nfn main() -> i32 {\n    print_i32(g1(%d));\n    0\n}\n' "$main" $p > "$OUT/p$p/f0.he"
+	p=$((p + 1))
+done
+
+# + gives the rule the descriptors of the jobserver
+{
+	printf 'all:'
+	p=0
+	while [ $p -lt "$PROGRAMS" ]; do printf ' p%d/prog' $p; p=$((p + 1)); done
+	printf '\n\n%%/prog:\n\t+$(HELANG_ENV) %s/helang $(HELANG_FLAGS) -c $(wildcard $*/*.he) -o $@ >/dev/null\n' "$BUILD"
+} > "$OUT/Makefile"
+
+# milliseconds of a clean build with the given make arguments
+measure() {
+	rm -f "$OUT"/p*/prog
+	start=$(date +%s%N)
+	make -s -C "$OUT" "$@"
+	end=$(date +%s%N)
+	echo $(((end - start) / 1000000))
+}
+
+echo "$((PROGRAMS * FILES)) files,make -j$JOBS"
+echo "jobserver:            $(measure -j"$JOBS") ms"
+echo "no jobserver,-j0:     $(measure -j"$JOBS" HELANG_ENV="env -u MAKEFLAGS" HELANG_FLAGS="-j 0") ms"
@@ -0,0 +1,40 @@
+#!/bin/sh
+# compile n files with one helang-c per file and with one helang-c --manifest,every file
+# pays for the process start,the llvm initialization and the target machine only in the first
+# usage: manifest_build.sh <build dir> [files] [jobs]
+set -e
+BUILD=$(cd "$1" && pwd)
+FILES=${2:-1000}
+JOBS=${3:-$(nproc)}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+f=0
+echo "[" > "$OUT/manifest.json"
+while [ $f -lt "$FILES" ]; do
+	{
+		echo "fn g$f(i32 x) -> i32 {"
+		k=0
+		while [ $k -lt 50 ]; do
+			echo "    i32 v$k = x * $k + $f;"
+			k=$((k + 1))
+		done
+		echo "    v49"
+		echo "}"
+	} > "$OUT/f$f.he"
+	[ $f -gt 0 ] && echo "," >> "$OUT/manifest.json"
+	printf '{"input":"%s","output":"%s"}' "$OUT/f$f.he" "$OUT/f$f.o" >> "$OUT/manifest.json"
+	f=$((f + 1))
+done
+echo "]" >> "$OUT/manifest.json"
+
+start=$(date +%s%N)
+ls "$OUT"/*.he | xargs -P "$JOBS" -I{} "$BUILD/helang-c" -c {} -o {}.o -p "$BUILD" > /dev/null
+end=$(date +%s%N)
+echo "one process per file : $(( (end - start) / 1000000 )) ms"
+
+start=$(date +%s%N)
+"$BUILD/helang-c" --manifest "$OUT/manifest.json" -j "$JOBS" --summary "$OUT/summary.json" -p "$BUILD" > /dev/null
+end=$(date +%s%N)
+echo "manifest             : $(( (end - start) / 1000000 )) ms"
+grep -E '"(setup_ms|total_ms)"' "$OUT/summary.json"
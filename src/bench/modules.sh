@@ -0,0 +1,96 @@
+#!/bin/sh
+# build a program of n modules of k functions once as modules importing each other and once as a
+# single file,then rebuild both after a change in the body of one function and in a signature
+# the single file compiles everything again,the modules compile the changed one and,for the
+# signature,the ones importing it
+# usage: modules.sh <build dir> [modules] [functions]
+set -e
+BUILD=$(cd "$1" && pwd)
+MODULES=${2:-50}
+FUNCS=${3:-40}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+mkdir "$OUT/mod" "$OUT/one"
+
+# module m calls the functions of module m-1,main calls the first function of every module
+module() {
+	m=$1
+	f=0
+	while [ $f -lt "$FUNCS" ]; do
+		echo "fn m${m}f$f(i32 x) -> i32 {"
+		k=0
+		while [ $k -lt 20 ]; do
+			echo "    i32 v$k = x * $k + $f;"
+			k=$((k + 1))
+		done
+		if [ "$m" -gt 0 ]; then
+			echo "    m$((m - 1))f$f(v19)"
+		else
+			echo "    v19"
+		fi
+		echo "}"
+		f=$((f + 1))
+	done
+}
+
+m=0
+: > "$OUT/one/main.he"
+echo "ccnd fn print_i32(i32 a);" > "$OUT/mod/main.he"
+while [ $m -lt "$MODULES" ]; do
+	[ $m -gt 0 ] && echo "import m$((m - 1));" > "$OUT/mod/m$m.he" || : > "$OUT/mod/m$m.he"
+	module $m >> "$OUT/mod/m$m.he"
+	module $m >> "$OUT/one/main.he"
+	echo "import m$m;" >> "$OUT/mod/main.he"
+	m=$((m + 1))
+done
+{
+	echo "fn main() -> i32 {"
+	echo "    print_i32(m$((MODULES - 1))f0(1));"
+	echo "    0"
+	echo "}"
+} | tee -a "$OUT/mod/main.he" >> "$OUT/one/main.he"
+sed -i '1i ccnd fn print_i32(i32 a);' "$OUT/one/main.he"
+
+build() {
+	start=$(date +%s%N)
+	(cd "$OUT/$1" && "$BUILD/helang" -c $2 -o prog > /dev/null)
+	end=$(date +%s%N)
+	printf "%-10s %-14s : %6d ms  %s\n" "$1" "$3" $(( (end - start) / 1000000 )) "$(cd "$OUT/$1" && ./prog | head -1)"
+}
+
+inputs=main.he
+m=0
+while [ $m -lt "$MODULES" ]; do
+	inputs="$inputs m$m.he"
+	m=$((m + 1))
+done
+
+build one main.he "clean"
+build mod "$inputs" "clean"
+
+# a body changes,the interface of m0 stays the same
+sed -i '/^fn m0f0(/,/^}/ s/v19 = x \* 19 + 0;/v19 = x * 19 + 7;/' "$OUT/one/main.he" "$OUT/mod/m0.he"
+build one main.he "body of m0f0"
+build mod "$inputs" "body of m0f0"
+
+# a signature changes,m1 imports m0 and is compiled again
+sed -i 's/^fn m0f1(i32 x) -> i32 {/fn m0f1(i32 x, i32 y) -> i32 {/; s/m0f1(v19)/m0f1(v19, 1)/' "$OUT/one/main.he" "$OUT/mod/m0.he" "$OUT/mod/m1.he"
+build one main.he "type of m0f1"
+build mod "$inputs" "type of m0f1"
+
+# the declarations main needs,read from the interfaces and from the sources,the in-memory builds
+# of the helang driver don't write interfaces,helang-c writes them when it compiles a module
+m=0
+while [ $m -lt "$MODULES" ]; do
+	"$BUILD/helang-c" -c "$OUT/mod/m$m.he" -o "$OUT/m$m.o" -p "$BUILD" > /dev/null
+	m=$((m + 1))
+done
+start=$(date +%s%N)
+"$BUILD/helang-c" -c "$OUT/mod/main.he" -o "$OUT/main.o" -p "$BUILD" > /dev/null
+end=$(date +%s%N)
+echo "main.he with the interfaces    : $(( (end - start) / 1000000 )) ms"
+rm "$OUT"/mod/m*.hei
+start=$(date +%s%N)
+"$BUILD/helang-c" -c "$OUT/mod/main.he" -o "$OUT/main.o" -p "$BUILD" > /dev/null
+end=$(date +%s%N)
+echo "main.he parsing the modules    : $(( (end - start) / 1000000 )) ms"
@@ -0,0 +1,38 @@
+#!/bin/sh
+# compile time of n files of k functions with helang-c -j 1,2 and 4,the files are compiled on
+# that many threads and need as many cores to scale
+# usage: parallel_compile.sh <build dir> [files] [functions]
+set -e
+BUILD=$(cd "$1" && pwd)
+FILES=${2:-64}
+FUNCS=${3:-300}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+inputs=""
+outputs=""
+f=0
+while [ $f -lt "$FILES" ]; do
+	k=0
+	while [ $k -lt "$FUNCS" ]; do
+		echo "fn f${f}g$k(i32 x) -> i32 {"
+		v=0
+		while [ $v -lt 20 ]; do
+			echo "    i32 v$v = x * $v + $k;"
+			v=$((v + 1))
+		done
+		echo "    v19"
+		echo "}"
+		k=$((k + 1))
+	done > "$OUT/f$f.he"
+	inputs="$inputs${inputs:+;}$OUT/f$f.he"
+	outputs="$outputs${outputs:+;}$OUT/f$f.o"
+	f=$((f + 1))
+done
+
+for jobs in 1 2 4; do
+	start=$(date +%s%N)
+	"$BUILD/helang-c" -c "$inputs" -o "$outputs" -j $jobs -p "$BUILD" > /dev/null
+	end=$(date +%s%N)
+	echo "-j $jobs : $(( (end - start) / 1000000 )) ms"
+done
@@ -0,0 +1,38 @@
+#!/bin/sh
+# run time of example/branchy.he built without a profile and with the profile of an instrumented
+# run of it,with and without --lto,every build must print the same
+# usage: pgo.sh <build dir> [iterations]
+set -e
+BUILD=$(cd "$1" && pwd)
+ITERATIONS=${2:-200000000}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+sed "s/work(200000000,/work($ITERATIONS,/" "$(dirname "$0")/../../example/branchy.he" > "$OUT/branchy.he"
+export HELANG_PROFILE="$OUT/branchy.heprof"
+
+# milliseconds of one run of a build,its output is kept to compare
+run() {
+	start=$(date +%s%N)
+	"$OUT/$1" > "$OUT/$1.out"
+	end=$(date +%s%N)
+	ms=$(( (end - start) / 1000000 ))
+	printf "%-20s : %6d ms\n" "$1" $ms >&2
+	echo $ms
+}
+
+"$BUILD/helang" -c "$OUT/branchy.he" -o "$OUT/instrumented" --profile-generate > /dev/null
+run instrumented > /dev/null
+"$BUILD/helang" -c "$OUT/branchy.he" -o "$OUT/plain" > /dev/null
+"$BUILD/helang" -c "$OUT/branchy.he" -o "$OUT/profiled" --profile-use "$HELANG_PROFILE" > /dev/null
+"$BUILD/helang" -c "$OUT/branchy.he" -o "$OUT/lto" --lto > /dev/null
+"$BUILD/helang" -c "$OUT/branchy.he" -o "$OUT/lto_profiled" --lto --profile-use "$HELANG_PROFILE" > /dev/null
+
+plain=$(run plain)
+profiled=$(run profiled)
+lto=$(run lto)
+lto_profiled=$(run lto_profiled)
+for kind in instrumented profiled lto lto_profiled; do
+	cmp "$OUT/plain.out" "$OUT/$kind.out"
+done
+echo "--profile-use       : $(( plain * 100 / (profiled > 0 ? profiled : 1) ))% of the speed without a profile"
+echo "--lto --profile-use : $(( lto * 100 / (lto_profiled > 0 ? lto_profiled : 1) ))% of the speed of --lto"
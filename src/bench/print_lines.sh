@@ -0,0 +1,95 @@
+#!/bin/sh
+# lines per second of print_i32 with the buffered runtime of libhelang_rt.a and with the printf
+# one it replaced,the same object of a helang loop is linked against both,print_i32_n is timed
+# from c on an array of the same values
+# then checks that a build with --lto prints the lines of a program before the one of main
+# usage: print_lines.sh <build dir> [lines]
+set -e
+BUILD=$(cd "$1" && pwd)
+LINES=${2:-10000000}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+cat > "$OUT/lines.he" <<HE
+ccnd fn print_i32(i32 a);
+fn lines(i32 n) -> i32 {
+    mut i32 r = 0;
+    if (n != 0) {
+        print_i32(n * 7919 - 1000000);
+        r = lines(n - 1);
+    }
+    r
+}
+fn main() -> i32 {
+    lines($LINES)
+}
+HE
+
+# print_i32 and main of template/io.c and template/main.c before the buffered runtime
+cat > "$OUT/printf_rt.c" <<'C'
+#include <stdio.h>
+extern int __he_entry_main();
+void print_i32(int n){
+    printf("saint he says: %d!\n", n);
+}
+int main(){
+    int num = __he_entry_main();
+    printf("so cool!helang exits and returns %d",num);
+}
+C
+
+cat > "$OUT/batch.c" <<C
+#include <stdint.h>
+#include <stdlib.h>
+void print_i32_n(const int32_t* values, int64_t count);
+int main(){
+    int32_t* v = malloc($LINES * sizeof(int32_t));
+    for(int64_t i = 0; i < $LINES; i++){
+        v[i] = (int32_t)((uint32_t)($LINES - i) * 7919u - 1000000u);
+    }
+    for(int64_t i = 0; i < $LINES; i += 4096){
+        print_i32_n(v + i, $LINES - i < 4096 ? $LINES - i : 4096);
+    }
+    return 0;
+}
+C
+
+"$BUILD/helang-c" -c "$OUT/lines.he" -o "$OUT/lines.o" -p "$BUILD" --runtime none > /dev/null
+cc -O2 -no-pie -o "$OUT/printf" "$OUT/lines.o" "$OUT/printf_rt.c"
+cc -O2 -no-pie -o "$OUT/buffered" "$OUT/lines.o" "$BUILD/libhelang_rt.a"
+cc -O2 -no-pie -o "$OUT/print_i32_n" "$OUT/batch.c" "$BUILD/libhelang_rt.a"
+
+for kind in printf buffered print_i32_n; do
+	start=$(date +%s%N)
+	"$OUT/$kind" > "$OUT/$kind.out"
+	end=$(date +%s%N)
+	ms=$(( (end - start) / 1000000 ))
+	echo "$kind : $ms ms,$(( LINES * 1000 / (ms > 0 ? ms : 1) )) lines per second"
+done
+# the runtimes print the same bytes
+cmp "$OUT/printf.out" "$OUT/buffered.out"
+head -n "$LINES" "$OUT/buffered.out" | cmp - "$OUT/print_i32_n.out"
+
+# the modules of an --lto build keep the copies of the runtime that main.c flushes visible,the
+# lines of the program come before the one of main and in the order of a build without it
+cat > "$OUT/order.he" <<'HE'
+ccnd fn print_i32(i32 a);
+fn main() -> i32 {
+    print_i32(1);
+    print_i32(2);
+    3
+}
+HE
+printf 'saint he says: 1!\nsaint he says: 2!\nso cool!helang exits and returns 3' > "$OUT/order.expected"
+"$BUILD/helang" -c "$OUT/order.he" -o "$OUT/order" > /dev/null
+"$BUILD/helang" -c "$OUT/order.he" -o "$OUT/order_lto" --lto > /dev/null
+"$OUT/order" > "$OUT/order.out"
+"$OUT/order_lto" > "$OUT/order_lto.out"
+for kind in order order_lto; do
+	if ! cmp -s "$OUT/order.expected" "$OUT/$kind.out"; then
+		echo "$kind prints its lines out of order:"
+		cat "$OUT/$kind.out"
+		exit 1
+	fi
+done
+echo "the lines of --lto and plain builds come in the same order"
@@ -0,0 +1,31 @@
+#!/bin/sh
+# per-file latency of helang-c started cold against helang-client talking to a running helang-c --server
+# usage: server_latency.sh <build dir> <file.he> [runs]
+set -e
+BUILD=$1
+INPUT=$2
+RUNS=${3:-50}
+OUT=$(mktemp -d)
+export HELANG_SOCKET="$OUT/helang.sock"
+
+# microseconds per compilation of INPUT by the given program
+measure() {
+	start=$(date +%s%N)
+	i=0
+	while [ $i -lt "$RUNS" ]; do
+		"$1" -c "$INPUT" -o "$OUT/out.o" >/dev/null
+		i=$((i + 1))
+	done
+	end=$(date +%s%N)
+	echo $(((end - start) / 1000 / RUNS))
+}
+
+cold=$(measure "$BUILD/helang-c")
+"$BUILD/helang-c" --server >/dev/null &
+SERVER=$!
+trap 'kill $SERVER 2>/dev/null; rm -rf "$OUT"' EXIT
+while [ ! -S "$HELANG_SOCKET" ]; do sleep 0.05; done
+warm=$(measure "$BUILD/helang-client")
+
+echo "helang-c:      $cold us per file"
+echo "helang-client: $warm us per file"
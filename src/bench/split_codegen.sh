@@ -0,0 +1,32 @@
+#!/bin/sh
+# compile time of one file of n functions with helang-c -s 1 and -s 4,the partitions are
+# generated on as many threads and need as many cores to scale
+# usage: split_codegen.sh <build dir> [functions]
+set -e
+BUILD=$(cd "$1" && pwd)
+FUNCS=${2:-100000}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+# every function calls the one before it so the partitions have calls across them
+k=0
+while [ $k -lt "$FUNCS" ]; do
+	echo "fn g$k(i32 x) -> i32 {"
+	echo "    i32 a = x * 3 + $k;"
+	echo "    i32 b = a / 7 + a * 5;"
+	if [ $k -gt 0 ]; then
+		echo "    g$((k - 1))(b)"
+	else
+		echo "    b"
+	fi
+	echo "}"
+	k=$((k + 1))
+done > "$OUT/big.he"
+
+for split in 1 4; do
+	start=$(date +%s%N)
+	"$BUILD/helang-c" -c "$OUT/big.he" -o "$OUT/big.o" -s $split -p "$BUILD" > /dev/null
+	end=$(date +%s%N)
+	echo "-s $split : $(( (end - start) / 1000000 )) ms,$(ls "$OUT"/big*.o | wc -l) object(s)"
+	rm -f "$OUT"/big*.o
+done
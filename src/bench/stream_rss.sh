@@ -0,0 +1,42 @@
+#!/bin/sh
+# compile one file of n functions at once and with --stream,the peak resident memory of the
+# first grows with the file and the one of the second with the batch
+# usage: stream_rss.sh <build dir> [functions] [batch tokens]
+set -e
+BUILD=$(cd "$1" && pwd)
+FUNCS=${2:-20000}
+BATCH=${3:-65536}
+OUT=$(mktemp -d)
+trap 'rm -rf "$OUT"' EXIT
+
+f=0
+{
+	echo "ccnd fn print_i32(i32 a);"
+	while [ $f -lt "$FUNCS" ]; do
+		echo "fn g$f(i32 x) -> i32 {"
+		k=0
+		while [ $k -lt 50 ]; do
+			echo "    i32 v$k = x * $k + $f;"
+			k=$((k + 1))
+		done
+		# every function calls one defined before it,in another batch for most of them
+		[ $f -gt 0 ] && echo "    g$((f / 2))(v49)" || echo "    v49"
+		echo "}"
+		f=$((f + 1))
+	done
+	echo "fn main() -> i32 {"
+	echo "    print_i32(g$((FUNCS - 1))(1));"
+	echo "    0"
+	echo "}"
+} > "$OUT/big.he"
+echo "source : $(( $(wc -c < "$OUT/big.he") / 1024 )) KiB,$FUNCS functions"
+
+for mode in "" "--stream $BATCH"; do
+	start=$(date +%s%N)
+	rss=$("$BUILD/helang-c" -c "$OUT/big.he" -o "$OUT/big.o" -p "$BUILD" --runtime none --max-rss $mode | grep "max rss")
+	end=$(date +%s%N)
+	objects=$(ls "$OUT"/big*.o | wc -l)
+	printf "%-16s : %6d ms  %s  %d objects\n" "${mode:-whole file}" $(( (end - start) / 1000000 )) "${rss#helang: }" "$objects"
+	cc -no-pie -o "$OUT/big" "$OUT"/big*.o "$BUILD/libhelang_rt.a"
+	"$OUT/big" | head -1
+done
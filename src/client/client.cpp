@@ -0,0 +1,53 @@
+#include "server.h"
+#include <filesystem>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+//helang-client takes the arguments of helang-c and sends them to helang-c --server,it runs the
+//helang-c next to it if no server is listening or the arguments run a program or read stdin,
+//these need the stdin and the environment of the user and not the ones of the server
+
+int main(int argc, const char** argvs) {
+	string socket_path = DefaultSocketPath();
+#ifdef _WIN32
+	string compiler = (fs::path(argvs[0]).parent_path() / "helang-c.exe").string();
+#else
+	string compiler = (fs::path(argvs[0]).parent_path() / "helang-c").string();
+#endif
+	vector<string> args = { compiler };
+	bool interactive = false;
+	for (int i = 1; i < argc; i++) {
+		string arg = argvs[i];
+		if (arg == "--socket" && i + 1 < argc) {
+			socket_path = argvs[++i];
+			continue;
+		}
+		interactive |= arg == "--run" || arg == "--repl" || arg == "--watch" || arg == "--lsp";
+		args.push_back(arg);
+	}
+
+	//stdin and the environment aren't forwarded
+	if (!interactive) {
+		if (auto v = RunClient(socket_path, args); v.has_value()) {
+			return v.value();
+		}
+	}
+	vector<const char*> local;
+	for (auto& a : args) {
+		local.push_back(a.c_str());
+	}
+	local.push_back(nullptr);
+	fflush(stdout);
+#ifdef _WIN32
+	return (int)_spawnv(_P_WAIT, local[0], local.data());
+#else
+	execv(local[0], (char* const*)local.data());
+	printf("helang: fail to run %s\n", local[0]);
+	return -1;
+#endif
+}
@@ -5,6 +5,17 @@
 #include "cmdline.h"
 #include "io.h"
 #include "codegen.h"
+#include "compiler.h"
+#include "jit.h"
+#include "bytecode.h"
+#include "repl.h"
+#include "watch.h"
+#include "server.h"
+#include "lsp.h"
+#include "runtime.h"
+#include "interface.h"
+#include "builddb.h"
+#include "stream.h"
 
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Support/FileSystem.h>
@@ -14,90 +25,611 @@
 #include <llvm/Target/TargetMachine.h>
 #include <llvm/Target/TargetOptions.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/CodeGen/ParallelCG.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
+#include <llvm/Analysis/ModuleSummaryAnalysis.h>
+#include <llvm/Analysis/ProfileSummaryInfo.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/FormatVariadic.h>
 
 #include <filesystem>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <unordered_set>
 namespace fs = std::filesystem;
 
-bool Compile(const string& input,const string& output,Config& config) {
-	ptr<LLVMCodeGenContext> context(new LLVMCodeGenContext(config));
-
-	string target_triple = llvm::sys::getDefaultTargetTriple();
-	context->llvm_module->setTargetTriple(target_triple);
+//split the module into config.split partitions and run instruction selection and object
+//emission of the partitions in parallel,partition k is written to PartitionObjectName(output,k)
+bool SplitCompile(llvm::Module& module, const string& output, Config& config, string& log) {
+	vector<unique_ptr<llvm::raw_fd_ostream>> files;
+	vector<llvm::raw_pwrite_stream*> streams;
+	for (u32 k = 0; k < config.split; k++) {
+		string name = PartitionObjectName(output, k);
+		std::error_code EC;
+		files.push_back(make_unique<llvm::raw_fd_ostream>(name, EC));
+		if (EC) {
+			log += "can't open file " + name + "\n";
+			return false;
+		}
+		streams.push_back(files.back().get());
+	}
 
-	string code;
-	if (auto v = IO::Get().LoadFile(input);v.has_value()) {
-		code = v.value();
+	bool res = EmitSplitObjects(module, streams, config, log);
+	for (u32 k = 0; k < config.split; k++) {
+		files[k]->close();
+		if (files[k]->has_error()) {
+			log += "helang: fail to write " + PartitionObjectName(output, k) + "," + files[k]->error().message() + "\n";
+			files[k]->clear_error();
+			res = false;
+		}
 	}
-	else {
-		printf("helang: fail to load file %s",input.c_str());
+	return res;
+}
+
+//write the module as bitcode with its thinlto summary to output
+bool EmitBitcode(llvm::Module& module, const string& output, string& log) {
+	std::error_code EC;
+	llvm::raw_fd_ostream dest(output, EC);
+	if (EC) {
+		log += "can't open file " + output + "\n";
 		return false;
 	}
+	EmitSummaryBitcode(module, dest);
+	dest.flush();
+	return true;
+}
 
-	vector<Token> tokens;
-	if (auto v = Lexer::Get().Parse(code);v.has_value()) {
-		tokens = v.value();
+//diagnostics are appended to log instead of printed so parallel compilations can report in input order
+//returns nullptr if input fails to compile,the ast is kept in ast_out if given
+ptr<LLVMCodeGenContext> Generate(const string& input,Config& config,llvm::TargetMachine* target_machine,string& log,
+	ptr<AST>* ast_out = nullptr) {
+	auto code = IO::Get().LoadFile(input);
+	if (!code.has_value()) {
+		log += "helang: fail to load file " + input + "\n";
+		return nullptr;
 	}
-	else {
-		printf("helang: %s",Lexer::Get().ErrorMsg().c_str());
-		return false;
+	ptr<AST> ast = ParseModule(code.value(), log);
+	if (ast == nullptr) {
+		return nullptr;
+	}
+	string error;
+	if (!ImportModules(*ast, input, config.interfaces, error)) {
+		log += "helang: " + error + "\n";
+		return nullptr;
+	}
+	ptr<LLVMCodeGenContext> context = GenerateParsedModule(input, *ast, config, target_machine, log);
+	if (context == nullptr) {
+		return nullptr;
 	}
+	if (config.interfaces && !WriteInterface(input, HashContent(code.value()), ast->Functions(), error)) {
+		log += "helang: " + error + "\n";
+		return nullptr;
+	}
+	if (ast_out != nullptr) {
+		*ast_out = ast;
+	}
+	return context;
+}
 
-	ptr<AST> ast(new AST);
-	if (!ast->Parse(tokens)) {
-		printf("helang: %s",ast->ErrorMsg().c_str());
+//write the module to output as config.emit asks
+bool Emit(LLVMCodeGenContext& context,const string& output,Config& config,llvm::TargetMachine* target_machine,string& log) {
+	if (config.emit == "bc") {
+		return EmitBitcode(*context.llvm_module, output, log);
+	}
+	if (config.split > 1) {
+		return SplitCompile(*context.llvm_module, output, config, log);
+	}
+
+	std::error_code EC;
+	llvm::raw_fd_ostream dest(output, EC);
+	if (EC) {
+		log += "can't open file " + output + "\n";
 		return false;
 	}
 
-	if (!context->GenerateCode(ast.get())) {
-		printf("helang: %s",ast->ErrorMsg().c_str());
+	if (!EmitObject(*context.llvm_module, target_machine, dest, log)) {
 		return false;
 	}
+	dest.flush();
+	return true;
+}
 
-	std::string error;
-	const llvm::Target* target = llvm::TargetRegistry::lookupTarget(target_triple, error);
-	if (target == nullptr) {
-		printf("fail to compile file %s reason : %s\n", input.c_str(), error.c_str());
+//compile input about config.stream tokens of top-level items at a time,see stream.h,batch k is
+//written to PartitionObjectName(output,k) and the partitions an earlier compilation left past the
+//last one are removed
+bool CompileStream(const string& input,const string& output,Config& config,llvm::TargetMachine* target_machine,string& log) {
+	string error;
+	auto source = ScanSignatures(input, error);
+	if (!source.has_value()) {
+		log += "helang: " + error + "\n";
 		return false;
 	}
+	vector<ptr<SignatureExpr>> defined;
+	for (auto& f : source->funcs) {
+		defined.push_back(f->GetSignature());
+	}
+	auto imported = LoadImports(source->imports, input, defined, source->declared, config.interfaces, error);
+	if (!imported.has_value()) {
+		log += "helang: " + error + "\n";
+		return false;
+	}
+	//a batch declares the functions of the other batches and modules it calls
+	unordered_map<string, ptr<SignatureExpr>> callees;
+	for (auto* sigs : { &imported.value(), &source->declared, &defined }) {
+		for (auto& sig : *sigs) {
+			callees[sig->GetName()] = sig;
+		}
+	}
 
-	llvm::TargetMachine* target_machine =
-		target->createTargetMachine(target_triple, "generic", "", llvm::TargetOptions{}, {});
-	context->llvm_module->setDataLayout(target_machine->createDataLayout());
+	ItemReader reader;
+	if (!reader.Open(input)) {
+		log += "helang: fail to load file " + input + "\n";
+		return false;
+	}
+	u32 k = 0;
+	for (bool end = false; !end;) {
+		vector<Token> batch;
+		while (batch.size() < config.stream) {
+			auto item = reader.Next(error);
+			if (!item.has_value()) {
+				log += "helang: " + error + "\n";
+				return false;
+			}
+			if (item->empty()) {
+				end = true;
+				break;
+			}
+			batch.insert(batch.end(), item->begin(), item->end());
+		}
+		//an empty source still gets its object
+		if (batch.empty() && k > 0) {
+			break;
+		}
+		AST ast;
+		bool parsed = ast.Parse(batch);
+		vector<Token>().swap(batch);
+		if (!parsed) {
+			log += "helang: " + ast.ErrorMsg() + "\n";
+			return false;
+		}
+		//functions defined in the batch or already declared
+		unordered_set<string> known;
+		for (auto& f : ast.Functions()) {
+			known.insert(f->GetSignature()->GetName());
+		}
+		vector<ptr<SignatureExpr>> declare;
+		for (auto& f : ast.Functions()) {
+			vector<CallExpr*> calls;
+			f->CollectCalls(calls);
+			for (auto call : calls) {
+				auto callee = callees.find(call->GetFunc());
+				if (callee != callees.end() && known.insert(call->GetFunc()).second) {
+					declare.push_back(callee->second);
+				}
+			}
+		}
+		ast.Import(declare);
 
+		ptr<LLVMCodeGenContext> context = GenerateParsedModule(input, ast, config, target_machine, log);
+		if (context == nullptr || !Emit(*context, PartitionObjectName(output, k), config, target_machine, log)) {
+			return false;
+		}
+		k++;
+	}
+	if (reader.Hash() != source->hash) {
+		log += "helang: " + input + " changed while it was compiled\n";
+		return false;
+	}
 	std::error_code EC;
-	llvm::raw_fd_ostream dest(output, EC);
-	if (EC) {
-		llvm::errs() << "can't open file " << output << "\n";
+	for (u32 stale = k; fs::remove(PartitionObjectName(output, stale), EC); stale++);
+	if (config.interfaces && !WriteInterface(input, source->hash, source->funcs, error)) {
+		log += "helang: " + error + "\n";
 		return false;
 	}
+	return true;
+}
 
-	llvm::legacy::PassManager pass_manager;
-	if (target_machine->addPassesToEmitFile(pass_manager,dest,nullptr,llvm::CGFT_ObjectFile)) {
-		llvm::errs() << "llvm can't emit object file\n";
+bool Compile(const string& input,const string& output,Config& config,llvm::TargetMachine* target_machine,string& log) {
+	if (config.stream > 0) {
+		return CompileStream(input, output, config, target_machine, log);
+	}
+	ptr<LLVMCodeGenContext> context = Generate(input, config, target_machine, log);
+	if (context == nullptr) {
 		return false;
 	}
+	return Emit(*context, output, config, target_machine, log);
+}
 
-	pass_manager.run(*context->llvm_module);
-	dest.flush();
+//target machine of this thread for the cpu and features of config,the files a worker compiles
+//share one instead of creating it per file
+llvm::TargetMachine* ThreadTargetMachine(Config& config, string& error) {
+	thread_local map<string, unique_ptr<llvm::TargetMachine>> machines;
+	auto& target_machine = machines[config.cpu + " " + config.features];
+	if (target_machine == nullptr) {
+		target_machine = CreateTargetMachine(config, error);
+	}
+	return target_machine.get();
+}
+
+//run compile for files 0..count-1 on jobs threads,logs are printed in file order as soon as the
+//files before them finish,no new file is started after a failure unless keep_going is set
+//returns false if any file failed
+bool RunJobs(u32 count, u32 jobs, bool keep_going, const function<bool(u32, string&)>& compile) {
+	vector<string> logs(count);
+	vector<u8> done(count, 0);
+	atomic<u32> next{ 0 };
+	atomic<bool> failed{ false };
+	u32 running = jobs;
+	mutex m;
+	condition_variable cv;
+
+	auto worker = [&]() {
+		while (keep_going || !failed) {
+			u32 i = next++;
+			if (i >= count) break;
+			if (!compile(i, logs[i])) failed = true;
+			lock_guard<mutex> lock(m);
+			done[i] = 1;
+			cv.notify_all();
+		}
+		lock_guard<mutex> lock(m);
+		running--;
+		cv.notify_all();
+	};
+
+	vector<thread> threads;
+	for (u32 i = 0; i < jobs; i++) {
+		threads.emplace_back(worker);
+	}
+
+	for (u32 i = 0; i < count; i++) {
+		unique_lock<mutex> lock(m);
+		cv.wait(lock, [&]() { return done[i] || running == 0; });
+		if (!done[i]) break;
+		lock.unlock();
+		fputs(logs[i].c_str(), stdout);
+	}
+	fflush(stdout);
+
+	for (auto& t : threads) {
+		t.join();
+	}
+	return !failed;
+}
+
+bool CompileAll(const vector<string>& input_file, const vector<string>& output_file, Config& config, u32 jobs) {
+	return RunJobs(input_file.size(), jobs, false, [&](u32 i, string& log) {
+		string error;
+		llvm::TargetMachine* target_machine = ThreadTargetMachine(config, error);
+		if (target_machine == nullptr) {
+			log = "fail to compile file " + input_file[i] + " reason : " + error + "\n";
+			return false;
+		}
+		return Compile(input_file[i], output_file[i], config, target_machine, log);
+	});
+}
+
+//the options of a single compilation,drive reads them from the command line and a manifest
+//from the flags of every entry,without defaults only the options given are set
+static vector<ParameterTable> CompileOptionTable(Config& config, bool with_defaults) {
+	auto value = [&](const char* v) { return with_defaults ? v : nullptr; };
+	auto flag = [&config](bool Config::* member) {
+		return [&config, member](ParamParser*, ParameterTable*, u32) { config.*member = true; };
+	};
+	return {
+		ParameterTable("dump",  "print generated ir to stdio",nullptr,flag(&Config::dump),false,{"-D","-d","--dump"}),
+		ParameterTable("specialize", "max call-site specializations per function,0 to disable",value("4"),nullptr,true,{"--specialize"}),
+		ParameterTable("spec_report", "print the call-site specializations created",nullptr,flag(&Config::specialize_report),false,{"--spec-report"}),
+		ParameterTable("warn_tail", "warn about calls in tail position that can't be guaranteed tail calls",nullptr,flag(&Config::warn_tail),false,{"--warn-tail"}),
+		ParameterTable("cpu", "target cpu,native for the host cpu,generic by default and native with --run and --repl",nullptr,nullptr,true,{"-mcpu"}),
+		ParameterTable("attr", "target features,e.g. +avx2,-bmi",nullptr,nullptr,true,{"-mattr"}),
+		ParameterTable("multiversion", "multiversion every function for runtime cpu dispatch",nullptr,flag(&Config::multiversion),false,{"--multiversion"}),
+		ParameterTable("mv_levels", "micro-architecture levels of multiversioned functions",value("v2;v3;v4"),nullptr,true,{"--mv-levels"}),
+		ParameterTable("split", "split every module into n partitions generated in parallel,partition k is written to <output>.k.o",value("1"),nullptr,true,{"-s","--split"}),
+		ParameterTable("stream", "read,generate and emit about n tokens of functions at a time so memory follows the largest function and not the file,batch k is written to <output>.k.o,0 compiles the file at once",value("0"),nullptr,true,{"--stream"}),
+		ParameterTable("emit", "output kind,obj for object files or bc for bitcode linked with thinlto",value("obj"),nullptr,true,{"--emit"}),
+		ParameterTable("profile_generate", "count branches and function entries,the program writes them to HELANG_PROFILE(default.heprof) at exit",nullptr,flag(&Config::profile_generate),false,{"--profile-generate"}),
+		ParameterTable("profile_use", "optimize with the branch and entry counts of a profile",nullptr,nullptr,true,{"--profile-use"}),
+	};
+}
+
+//set config from the values of CompileOptionTable the parser holds,the cpu isn't resolved
+//profiles are loaded once per path,returns false with error set if a value is invalid
+static bool ReadCompileOptions(ParamParser& parser, Config& config, map<string, ptr<Profile>>& profiles, string& error) {
+	auto number = [&](const char* key, u32& out) {
+		if (!parser.Get<string>(key).has_value()) {
+			return true;
+		}
+		if (auto v = parser.Get<u32>(key); v.has_value()) {
+			out = v.value();
+			return true;
+		}
+		error = string("invalid ") + key + " value " + parser.Get<string>(key).value();
+		return false;
+	};
+	if (!number("specialize", config.specialize_limit) || !number("split", config.split) ||
+		!number("stream", config.stream)) {
+		return false;
+	}
+	config.split = max<u32>(config.split, 1);
+	//the batches of a streamed file take the partition names
+	if (config.stream > 0 && config.split > 1) {
+		error = "--stream writes an object per batch,it can't be combined with --split";
+		return false;
+	}
+	if (auto v = parser.Get<string>("cpu"); v.has_value()) {
+		config.cpu = v.value();
+	}
+	if (auto v = parser.Get<string>("attr"); v.has_value()) {
+		config.features = v.value();
+	}
+	if (auto v = parser.Get<string>("mv_levels"); v.has_value()) {
+		config.multiversion_levels = UnzipString(v.value());
+		for (auto& l : config.multiversion_levels) {
+			if (!IsMicroArchLevel(l)) {
+				error = "unknown micro-architecture level " + l + ",expect v2,v3 or v4";
+				return false;
+			}
+		}
+	}
+	if (auto v = parser.Get<string>("emit"); v.has_value()) {
+		config.emit = v.value();
+		if (config.emit != "obj" && config.emit != "bc") {
+			error = "unknown output kind " + config.emit + ",expect obj or bc";
+			return false;
+		}
+	}
+	if (auto v = parser.Get<string>("profile_use"); v.has_value()) {
+		auto& profile = profiles[v.value()];
+		if (profile == nullptr) {
+			auto p = Profile::Load(v.value(), error);
+			if (!p.has_value()) {
+				return false;
+			}
+			profile = make_shared<Profile>(std::move(p.value()));
+		}
+		config.profile = profile;
+	}
 	return true;
 }
 
-int main(int argc,const char** argvs) {
+struct ManifestEntry
+{
+	string input, output;
 	Config config;
-	auto dump_ir_callback = [&](ParamParser*, ParameterTable*, u32) {
-		config.dump = true;
+	bool ok = false;
+	double generate_ms = 0, emit_ms = 0;
+};
+
+//the manifest is a json array of {"input":"a.he","output":"a.o","flags":["--specialize","0"]},
+//flags are compile options that override the command line for that entry only
+static optional<vector<ManifestEntry>> LoadManifest(const string& path, Config& config, string& error) {
+	auto text = IO::Get().LoadFile(path);
+	if (!text.has_value()) {
+		error = "fail to load manifest " + path;
+		return {};
+	}
+	auto root = llvm::json::parse(text.value());
+	if (!root) {
+		error = "manifest " + path + " : " + llvm::toString(root.takeError());
+		return {};
+	}
+	llvm::json::Array* array = root->getAsArray();
+	if (array == nullptr) {
+		error = "manifest " + path + " : expect an array of entries";
+		return {};
+	}
+
+	Config names_config;
+	vector<ParameterTable> names_table = CompileOptionTable(names_config, false);
+	map<string, ParameterTable*> names;
+	for (auto& t : names_table) {
+		for (auto n : t.names) names[n] = &t;
+	}
+
+	map<string, ptr<Profile>> profiles;
+	vector<ManifestEntry> entries;
+	for (u32 i = 0; i < array->size(); i++) {
+		string at = "manifest " + path + " entry " + to_string(i) + " : ";
+		llvm::json::Object* object = (*array)[i].getAsObject();
+		if (object == nullptr) {
+			error = at + "expect an object";
+			return {};
+		}
+		auto input = object->getString("input");
+		auto output = object->getString("output");
+		if (!input.hasValue() || !output.hasValue()) {
+			error = at + "expect input and output strings";
+			return {};
+		}
+		ManifestEntry entry;
+		entry.input = input->str();
+		entry.output = output->str();
+		entry.config = config;
+
+		vector<string> flags;
+		if (auto* v = object->get("flags"); v != nullptr) {
+			llvm::json::Array* list = v->getAsArray();
+			if (list == nullptr) {
+				error = at + "expect flags to be an array of strings";
+				return {};
+			}
+			for (auto& f : *list) {
+				auto flag = f.getAsString();
+				if (!flag.hasValue()) {
+					error = at + "expect flags to be an array of strings";
+					return {};
+				}
+				flags.push_back(flag->str());
+			}
+		}
+		//the parser exits on an unknown option,the manifest reports it instead
+		vector<const char*> args;
+		for (auto& f : flags) {
+			if (f[0] == '-' && !names.count(f) && !names.count(f.substr(0, f.find('=')))) {
+				error = at + "unknown flag " + f;
+				return {};
+			}
+			args.push_back(f.c_str());
+		}
+		vector<ParameterTable> table = CompileOptionTable(entry.config, false);
+		ParamParser parser(args.size(), args.data(), table.size(), table.data());
+		if (!ReadCompileOptions(parser, entry.config, profiles, error)) {
+			error = at + error;
+			return {};
+		}
+		ResolveTargetCPU(entry.config);
+		entries.push_back(std::move(entry));
+	}
+	return entries;
+}
+
+static double Milliseconds(chrono::steady_clock::time_point from, chrono::steady_clock::time_point to) {
+	return chrono::duration<double, milli>(to - from).count();
+}
+
+//compile every entry of the manifest on jobs threads,a failed entry doesn't stop the others
+//summary,if given,receives the time every entry took as json
+static int CompileManifest(const string& path, Config& config, u32 jobs, optional<string> summary,
+	chrono::steady_clock::time_point start) {
+	string error;
+	auto loaded = LoadManifest(path, config, error);
+	if (!loaded.has_value()) {
+		printf("helang: %s\n", error.c_str());
+		return -1;
+	}
+	vector<ManifestEntry>& entries = loaded.value();
+	jobs = min<u32>(jobs, max<usize>(entries.size(), 1));
+
+	auto compile_start = chrono::steady_clock::now();
+	bool ok = RunJobs(entries.size(), jobs, true, [&](u32 i, string& log) {
+		ManifestEntry& entry = entries[i];
+		string error;
+		llvm::TargetMachine* target_machine = ThreadTargetMachine(entry.config, error);
+		if (target_machine == nullptr) {
+			log = "fail to compile file " + entry.input + " reason : " + error + "\n";
+			return false;
+		}
+		auto t0 = chrono::steady_clock::now();
+		//a streamed entry generates and emits its batches in turn,the time is counted as generation
+		if (entry.config.stream > 0) {
+			entry.ok = CompileStream(entry.input, entry.output, entry.config, target_machine, log);
+			entry.generate_ms = Milliseconds(t0, chrono::steady_clock::now());
+			return entry.ok;
+		}
+		ptr<LLVMCodeGenContext> context = Generate(entry.input, entry.config, target_machine, log);
+		auto t1 = chrono::steady_clock::now();
+		entry.generate_ms = Milliseconds(t0, t1);
+		if (context == nullptr) {
+			return false;
+		}
+		entry.ok = Emit(*context, entry.output, entry.config, target_machine, log);
+		entry.emit_ms = Milliseconds(t1, chrono::steady_clock::now());
+		return entry.ok;
+	});
+	auto end = chrono::steady_clock::now();
+
+	if (summary.has_value()) {
+		llvm::json::Array files;
+		u32 failed = 0;
+		for (auto& e : entries) {
+			failed += !e.ok;
+			files.push_back(llvm::json::Object{
+				{ "input", e.input }, { "output", e.output }, { "ok", e.ok },
+				{ "generate_ms", e.generate_ms }, { "emit_ms", e.emit_ms }, { "ms", e.generate_ms + e.emit_ms } });
+		}
+		llvm::json::Object result{
+			{ "files", std::move(files) }, { "compiled", (int64_t)entries.size() - failed }, { "failed", failed },
+			{ "jobs", jobs }, { "setup_ms", Milliseconds(start, compile_start) }, { "total_ms", Milliseconds(start, end) } };
+		std::error_code EC;
+		llvm::raw_fd_ostream out(summary.value(), EC);
+		if (EC) {
+			printf("helang: can't open file %s\n", summary->c_str());
+			return -1;
+		}
+		out << llvm::formatv("{0:2}", llvm::json::Value(std::move(result))) << "\n";
+	}
+	return ok ? 0 : -1;
+}
+
+int Drive(int argc,const char** argvs) {
+	auto start = chrono::steady_clock::now();
+	Config config;
+	bool run = false;
+	auto run_callback = [&](ParamParser*, ParameterTable*, u32) {
+		run = true;
+	};
+	auto jit_lazy_callback = [&](ParamParser*, ParameterTable*, u32) {
+		config.jit_lazy = true;
+	};
+	bool watch = false;
+	auto watch_callback = [&](ParamParser*, ParameterTable*, u32) {
+		watch = true;
+	};
+	bool repl = false;
+	auto repl_callback = [&](ParamParser*, ParameterTable*, u32) {
+		repl = true;
+	};
+	bool lsp = false;
+	auto lsp_callback = [&](ParamParser*, ParameterTable*, u32) {
+		lsp = true;
+	};
+	bool max_rss = false;
+	auto max_rss_callback = [&](ParamParser*, ParameterTable*, u32) {
+		max_rss = true;
 	};
 	config.dump = false;
+	config.specialize_report = false;
+	config.warn_tail = false;
+	config.multiversion = false;
+	config.profile_generate = false;
+	config.jit_lazy = false;
 
-	ParameterTable paramTable[] = {
+	vector<ParameterTable> paramTable = {
 		ParameterTable("output","the output .o file",nullptr,nullptr,true,{"-O","-o","--ouptut"}),
 		ParameterTable("input", "the input .he file",nullptr,nullptr,true,{"-C","-c","--compile"}),
 		ParameterTable("help",  "print a helper message",nullptr,print_help_message,false,{"-H","-h","--help"}),
-		ParameterTable("dump",  "print generated ir to stdio",nullptr,dump_ir_callback,false,{"-D","-d","--dump"}),
 		ParameterTable("path",  "search path of the compiler",nullptr,nullptr,true,{"-P","-p","--path"}),
+		ParameterTable("jobs", "number of files compiled in parallel,0 for one per hardware thread","1",nullptr,true,{"-j","--jobs"}),
+		ParameterTable("manifest", "compile the entries of a json array of {input,output,flags} instead of -c and -o",nullptr,nullptr,true,{"--manifest"}),
+		ParameterTable("summary", "with --manifest,write the compile time of every entry as json to a file",nullptr,nullptr,true,{"--summary"}),
+		ParameterTable("max_rss", "print the peak resident memory of the compilation",nullptr,max_rss_callback,false,{"--max-rss"}),
+		ParameterTable("runtime", "runtime bitcode linked into every module so its calls can be inlined,helang_rt.bc next to helang-c by default,none to leave the runtime to the linker",nullptr,nullptr,true,{"--runtime"}),
 	};
+	vector<ParameterTable> compileOptions = CompileOptionTable(config, true);
+	paramTable.insert(paramTable.end(), compileOptions.begin(), compileOptions.end());
+	paramTable.insert(paramTable.end(), {
+		ParameterTable("run", "compile the files in memory and run them with the jit,the exit code is the value of main",nullptr,run_callback,false,{"--run"}),
+		ParameterTable("jit_lazy", "with --run,compile every function on its first call",nullptr,jit_lazy_callback,false,{"--jit-lazy"}),
+		ParameterTable("jit_threads", "with --run,number of background compile threads,0 compiles on the calling thread","0",nullptr,true,{"--jit-threads"}),
+		ParameterTable("engine", "with --run,jit compiles everything,interp interprets bytecode,tiered promotes hot functions to the jit","jit",nullptr,true,{"--engine"}),
+		ParameterTable("tier_threshold", "with --engine tiered,calls and loop iterations before a function is compiled","1000",nullptr,true,{"--tier-threshold"}),
+		ParameterTable("watch", "with --run,compile the functions changed in the inputs again while the program runs",nullptr,watch_callback,false,{"--watch"}),
+		ParameterTable("repl", "read functions and statements from stdin and run them with the jit,the inputs are loaded first",nullptr,repl_callback,false,{"--repl"}),
+		ParameterTable("lsp", "run a language server on stdin and stdout",nullptr,lsp_callback,false,{"--lsp"}),
+		ParameterTable("server", "keep llvm loaded and serve the compilations forwarded by helang-client",nullptr,nullptr,false,{"--server"}),
+		ParameterTable("socket", "socket of --server,HELANG_SOCKET or helang.sock in XDG_RUNTIME_DIR or in helang-<uid> of the temp directory by default,its directory must belong to this user with mode 0700",nullptr,nullptr,true,{"--socket"}),
+	});
 
-	ParamParser parser(argc - 1, argvs + 1, he_countof(paramTable), paramTable);
+	//@file arguments hold one argument per line,for command lines too long for the shell
+	vector<string> expanded(argvs + 1, argvs + argc);
+	if (string error; !ExpandResponseFiles(expanded, error)) {
+		printf("helang: %s\n", error.c_str());
+		return -1;
+	}
+	vector<const char*> args;
+	for (auto& a : expanded) {
+		args.push_back(a.c_str());
+	}
+	ParamParser parser(args.size(), args.data(), paramTable.size(), paramTable.data());
+	if (lsp) {
+		return RunLanguageServer();
+	}
 	
 	llvm::InitializeAllTargetInfos();
 	llvm::InitializeAllTargets();
@@ -107,9 +639,17 @@ int main(int argc,const char** argvs) {
 
 	string target = llvm::sys::getDefaultTargetTriple();
 
+	optional<string> manifest = parser.Get<string>("manifest");
 	vector<string> input_file, output_file;
-	input_file = UnzipString(parser.Require<string>("input"));
-	output_file = UnzipString(parser.Require<string>("output"));
+	if (!repl && !manifest.has_value()) {
+		input_file = UnzipString(parser.Require<string>("input"));
+	}
+	else if (auto v = parser.Get<string>("input"); v.has_value()) {
+		input_file = UnzipString(v.value());
+	}
+	if (!run && !repl && !manifest.has_value()) {
+		output_file = UnzipString(parser.Require<string>("output"));
+	}
 	/*if (auto v = parser.Get<string>("output_file");v.has_value()) {
 		output_file = UnzipString(v.value());
 		if (input_file.size() != output_file.size()) {
@@ -135,12 +675,142 @@ int main(int argc,const char** argvs) {
 		printf("fail to initialize io system");
 		return -1;
 	}
-	Lexer::Initialize(config);
-	
-	for (u32 i = 0; i < input_file.size();i++) {
-		if (!Compile(input_file[i],output_file[i],config)) {
+	//jitted code calls the runtime of this process
+	if (!run && !repl) {
+		auto v = parser.Get<string>("runtime");
+		string runtime = v.value_or((fs::path(argvs[0]).parent_path() / "helang_rt.bc").string());
+		if (runtime != "none") {
+			config.runtime = LoadRuntime(runtime);
+		}
+		if (config.runtime == nullptr && v.has_value() && runtime != "none") {
+			printf("helang: fail to load runtime bitcode %s\n", runtime.c_str());
+			return -1;
+		}
+	}
+	map<string, ptr<Profile>> profiles;
+	if (string error; !ReadCompileOptions(parser, config, profiles, error)) {
+		printf("helang: %s\n", error.c_str());
+		return -1;
+	}
+	//jitted code runs on this machine,an explicit -mcpu=generic is kept
+	if (config.cpu.empty()) {
+		config.cpu = run || repl ? "native" : "generic";
+	}
+	//only a compilation writing objects or bitcode writes interfaces
+	config.interfaces = !run && !repl;
+	u32 jobs = parser.Require<u32>("jobs");
+	if (jobs == 0) {
+		jobs = max<u32>(thread::hardware_concurrency(), 1);
+	}
+	//the entries resolve the cpu after their own -mcpu and -mattr
+	auto report = [&](int rtv) {
+		if (max_rss) {
+			printf("helang: max rss %llu KiB\n", (unsigned long long)(PeakResidentSize() / 1024));
+		}
+		return rtv;
+	};
+	if (manifest.has_value()) {
+		return report(CompileManifest(manifest.value(), config, jobs, parser.Get<string>("summary"), start));
+	}
+	ResolveTargetCPU(config);
+	if (repl) {
+		config.jit_threads = 0;
+		return RunRepl(config, input_file);
+	}
+
+	if (run) {
+		config.jit_threads = parser.Require<u32>("jit_threads");
+		config.engine = parser.Require<string>("engine");
+		config.tier_threshold = max<u32>(parser.Require<u32>("tier_threshold"), 1);
+		if (config.engine != "jit" && config.engine != "interp" && config.engine != "tiered") {
+			printf("helang: unknown engine %s,expect jit,interp or tiered\n", config.engine.c_str());
+			return -1;
+		}
+		if (watch) {
+			if (config.engine != "jit") {
+				printf("helang: --watch needs the jit engine\n");
+				return -1;
+			}
+			return RunWatch(config, input_file, argvs);
+		}
+		string error;
+		unique_ptr<llvm::TargetMachine> target_machine = CreateTargetMachine(config, error);
+		if (target_machine == nullptr) {
+			printf("helang: %s\n", error.c_str());
 			return -1;
 		}
+		vector<ptr<LLVMCodeGenContext>> modules;
+		vector<ptr<AST>> asts;
+		for (auto& input : input_file) {
+			string log;
+			ptr<AST> ast;
+			ptr<LLVMCodeGenContext> context = Generate(input, config, target_machine.get(), log, &ast);
+			fputs(log.c_str(), stdout);
+			if (context == nullptr) {
+				return -1;
+			}
+			modules.push_back(context);
+			asts.push_back(ast);
+		}
+		fflush(stdout);
+
+		optional<int> rtv;
+		if (config.engine == "jit") {
+			rtv = RunJIT(modules, config, error);
+		}
+		else {
+			BytecodeProgram program;
+			for (u32 i = 0; i < asts.size(); i++) {
+				if (!asts[i]->DeclareBytecode(program, i)) {
+					printf("helang: %s\n", asts[i]->ErrorMsg().c_str());
+					return -1;
+				}
+			}
+			for (u32 i = 0; i < asts.size(); i++) {
+				if (!asts[i]->GenerateBytecode(program, i)) {
+					printf("helang: %s\n", asts[i]->ErrorMsg().c_str());
+					return -1;
+				}
+			}
+			rtv = RunBytecode(program, modules, config, error);
+		}
+		if (!rtv.has_value()) {
+			printf("helang: %s\n", error.c_str());
+			return -1;
+		}
+		return rtv.value();
+	}
+
+	if (input_file.size() != output_file.size()) {
+		printf("the count of input files must equal to count of output files\n");
+		return -1;
 	}
-	return 0;
-}
\ No newline at end of file
+
+	jobs = min<u32>(jobs, input_file.size());
+	return report(CompileAll(input_file, output_file, config, jobs) ? 0 : -1);
+}
+
+//--server is handled before the arguments are parsed,the server runs the rest of the command
+//line of every request
+int main(int argc,const char** argvs) {
+	string socket_path = DefaultSocketPath();
+	vector<const char*> args;
+	bool server = false;
+	for (int i = 0; i < argc; i++) {
+		string arg = argvs[i];
+		if (arg == "--server") {
+			server = true;
+		}
+		else if (arg == "--socket" && i + 1 < argc) {
+			socket_path = argvs[++i];
+		}
+		else {
+			args.push_back(argvs[i]);
+		}
+	}
+	if (server) {
+		return RunServer(socket_path, Drive);
+	}
+	args.push_back(nullptr);
+	return Drive(args.size() - 1, args.data());
+}
@@ -3,8 +3,17 @@
 #include <stack>
 
 extern const char* g_token_type_name_table[HE_TOKEN_COUNT];
-extern unordered_map<string, u32> g_operator_priority;
+extern const unordered_map<string, u32> g_operator_priority;
 
+//g_operator_priority is shared by every compile thread
+static u32 OperatorPriority(const string& op)
+{
+	if (auto v = g_operator_priority.find(op); v != g_operator_priority.end())
+	{
+		return v->second;
+	}
+	return 0;
+}
 
 
 class ASTParser 
@@ -13,6 +22,7 @@ public:
 	ASTParser(const vector<Token>& tokens):tokens(tokens) {}
 
 	optional<ptr<TopLevelExpr>> Parse(string& error);
+	optional<ptr<TopLevelExpr>> ParseEntry(const string& name, string& error);
 
 private:
 	optional<ptr<SignatureExpr>> ParseExtern(u32 start,u32& end,string& error);
@@ -80,8 +90,12 @@ private:
 	//prim  ::= num | var | paren | call
 	optional<u32> FindNextPrimExprEnd(u32 start,u32 end) 
 	{
-		he_assert(start < tokens.size() && end < tokens.size());
-		he_assert(tokens[start].type != HE_TOKEN_BINOP);
+		he_assert(end <= tokens.size());
+		//an operator or the end where an operand is expected,e.g. while the code is being typed
+		if (start >= end || tokens[start].type == HE_TOKEN_BINOP)
+		{
+			return {};
+		}
 
 		if (PeekExpect(HE_TOKEN_LPARENTHESE, start)) 
 		{
@@ -159,6 +173,9 @@ private:
 
 	string ErrorPrefix(u32 i) 
 	{
+		//an error at eof is reported at the last token
+		i = min<u32>(i, tokens.size() - 1);
+		error_at = i;
 		return "fail to parse ast error at (" + to_string(tokens[i].line) + ":" + to_string(tokens[i].start) + "-" + to_string(tokens[i].end) + ")";
 	}
 
@@ -169,10 +186,34 @@ private:
 
 	string ErrorMismatch(u32 i,HE_TOKEN_TYPE expect) 
 	{
+		if (i >= tokens.size())
+		{
+			return ErrorEOF(i, expect);
+		}
 		return ErrorPrefix(i) + "expect a " + g_token_type_name_table[expect] + " but " + g_token_type_name_table[tokens[i].type] + " was found";
 	}
 
+	//content hash of tokens[start,end),positions are left out so moving code around doesn't change it
+	u64 HashTokens(u32 start, u32 end)
+	{
+		u64 hash = 14695981039346656037ull;
+		for (u32 i = start; i < end; i++)
+		{
+			for (unsigned char c : tokens[i].token)
+			{
+				hash = (hash ^ c) * 1099511628211ull;
+			}
+			hash = (hash ^ 0xff) * 1099511628211ull;
+		}
+		return hash;
+	}
+
 	vector<Token> tokens;
+	//token the last error is reported at
+	optional<u32> error_at;
+
+public:
+	optional<Token> ErrorToken() { return error_at.has_value() ? optional<Token>(tokens[error_at.value()]) : nullopt; }
 };
 
 
@@ -204,7 +245,14 @@ optional<ptr<SignatureExpr>> ASTParser::ParseSignature(u32 start, u32& end, stri
 		while (true)
 		{
 			string type, arg;
-			Consume(p, &type);
+			if (auto v = ConsumeExpect(HE_TOKEN_IDENTIFIER, p, &error); v.has_value())
+			{
+				type = v.value();
+			}
+			else
+			{
+				return {};
+			}
 			if (auto v = ConsumeExpect(HE_TOKEN_IDENTIFIER, p, &error); v.has_value())
 			{
 				arg = v.value();
@@ -395,6 +443,11 @@ optional<ptr<Expr>>     ASTParser::ParseExpression(u32 start, u32 end, string& e
 	{
 		return lhs;
 	}
+	else if (!PeekExpect(HE_TOKEN_BINOP, prim_end))
+	{
+		error = ErrorMismatch(prim_end, HE_TOKEN_BINOP);
+		return {};
+	}
 	else 
 	{
 		return ParseBinExpression(prim_end, end, lhs, error);
@@ -490,7 +543,7 @@ optional<ptr<Expr>>	ASTParser::ParseBinExpression(u32 start, u32 end, ptr<Expr>
 
 		string op; 
 		Consume(p, &op);
-		curr_prior = g_operator_priority[op];
+		curr_prior = OperatorPriority(op);
 
 		u32 prim_end;
 		if (auto v = FindNextPrimExprEnd( p,end);v.has_value()) {
@@ -516,7 +569,7 @@ optional<ptr<Expr>>	ASTParser::ParseBinExpression(u32 start, u32 end, ptr<Expr>
 		{
 			u32 next_prior;
 			string next_op = tokens[p].token;
-			next_prior = g_operator_priority[next_op];
+			next_prior = OperatorPriority(next_op);
 			if (next_prior > curr_prior) 
 			{
 				if (auto v = ParseBinExpression(p, end, rhs, error);v.has_value()) 
@@ -682,8 +735,8 @@ optional<ptr<Expr>>	ASTParser::ParsePrimExpression(u32 start, u32 end, string& e
 {
 	if (start == end) 
 	{
-		error = ErrorPrefix(start) + " expect a primary expression but a " + g_token_type_name_table[tokens[start].type] + 
-			" was found";
+		error = ErrorPrefix(start) + " expect a primary expression but a " + 
+			(start < tokens.size() ? g_token_type_name_table[tokens[start].type] : "eof") + " was found";
 		return {};
 	}
 	//num or identifier
@@ -701,12 +754,19 @@ optional<ptr<Expr>>	ASTParser::ParsePrimExpression(u32 start, u32 end, string& e
 			Consume(start, &variable);
 			return ptr<VariableExpr>(new VariableExpr(variable, tokens[start]));
 		}
+		error = ErrorPrefix(start) + " expect a primary expression but a " + g_token_type_name_table[tokens[start].type] +
+			" was found";
+		return {};
 	}
 	else 
 	{
 		if (PeekExpect(HE_TOKEN_LPARENTHESE,start)) 
 		{
-			assert(tokens[end - 1].type == HE_TOKEN_RPARENTHESE);
+			if (tokens[end - 1].type != HE_TOKEN_RPARENTHESE)
+			{
+				error = ErrorPrefix(start) + " no matching right parenthese for '('";
+				return {};
+			}
 			if (auto v = ParseExpression(start + 1, end - 1, error);v.has_value()) 
 			{
 				return v.value();
@@ -765,9 +825,19 @@ optional<ptr<TopLevelExpr>> ASTParser::Parse(string& error)
 {
 	vector<ptr<FuncExpr>> funcs;
 	vector<ptr<SignatureExpr>> sigs;
+	vector<Token> imports;
 	u32 p = 0,end = 0;
 	while (p < tokens.size()) 
 	{
+		//import ::= import identifier ;
+		if (PeekExpect(HE_TOKEN_IMPORT, p)) {
+			Consume(p, nullptr);
+			if (!ConsumeExpect(HE_TOKEN_IDENTIFIER, p, &error) || !ConsumeExpect(HE_TOKEN_SEMICOLON, p, &error)) {
+				return {};
+			}
+			imports.push_back(tokens[p - 2]);
+			continue;
+		}
 		if (PeekExpect(HE_TOKEN_EXTERN,p)) {
 			if (auto v = ParseExtern(p, end, error);v.has_value()) {
 				sigs.push_back(v.value());
@@ -779,6 +849,14 @@ optional<ptr<TopLevelExpr>> ASTParser::Parse(string& error)
 			continue;
 		}
 
+		u32 func_start = p;
+		bool multiversion = false;
+		if (PeekExpect(HE_TOKEN_MULTIVERSION, p))
+		{
+			Consume(p, nullptr);
+			multiversion = true;
+		}
+
 		if (!PeekExpect(HE_TOKEN_FUNC,p))
 		{
 			error = ErrorMismatch(p, HE_TOKEN_FUNC);
@@ -786,6 +864,8 @@ optional<ptr<TopLevelExpr>> ASTParser::Parse(string& error)
 		}
 		if (auto f = ParseFunc(p, end, error); f.has_value())
 		{
+			if (multiversion) f.value()->MarkMultiversion();
+			f.value()->SetHash(HashTokens(func_start, end));
 			funcs.push_back(f.value());
 		}
 		else 
@@ -794,7 +874,45 @@ optional<ptr<TopLevelExpr>> ASTParser::Parse(string& error)
 		}
 		p = end;
 	}
-	return ptr<TopLevelExpr>(new TopLevelExpr(funcs, sigs, tokens[0]));
+	//an empty file
+	Token first = tokens.empty() ? Token{ HE_TOKEN_SEMICOLON, "", 1, 0, 0 } : tokens[0];
+	return ptr<TopLevelExpr>(new TopLevelExpr(funcs, sigs, first, imports));
+}
+
+//entry ::= top | body
+optional<ptr<TopLevelExpr>> ASTParser::ParseEntry(const string& name, string& error)
+{
+	if (tokens.empty())
+	{
+		error = "empty entry";
+		return {};
+	}
+	if (PeekExpect(HE_TOKEN_FUNC, 0) || PeekExpect(HE_TOKEN_EXTERN, 0) || PeekExpect(HE_TOKEN_MULTIVERSION, 0) ||
+		PeekExpect(HE_TOKEN_IMPORT, 0))
+	{
+		return Parse(error);
+	}
+
+	//the statements are parsed like a function body,which is closed by a curly
+	Token close = tokens.back();
+	close.type = HE_TOKEN_RCURLY;
+	close.token = "}";
+	tokens.push_back(close);
+	ptr<BodyExpr> body;
+	if (auto v = ParseBody(0, tokens.size() - 1, error); v.has_value())
+	{
+		body = v.value();
+	}
+	else
+	{
+		return {};
+	}
+	vector<Declearation> args;
+	ptr<SignatureExpr> signature(new SignatureExpr("u8", name, args, tokens[0]));
+	ptr<FuncExpr> func(new FuncExpr(signature, body, tokens[0]));
+	func->MarkEcho();
+	vector<ptr<SignatureExpr>> sigs;
+	return ptr<TopLevelExpr>(new TopLevelExpr({ func }, sigs, tokens[0]));
 }
 
 optional<ptr<SignatureExpr>> ASTParser::ParseExtern(u32 start, u32& end, string& error){
@@ -807,8 +925,19 @@ optional<ptr<SignatureExpr>> ASTParser::ParseExtern(u32 start, u32& end, string&
 		error = ErrorPrefix(start) + " expected a ';' at end of can can need";
 		return {};
 	}
+	if (!PeekExpect(HE_TOKEN_FUNC, p))
+	{
+		error = ErrorMismatch(p, HE_TOKEN_FUNC);
+		return {};
+	}
+	u32 semicolon = end;
 	auto rv = ParseSignature(p, end, error);
-	end += 1;
+	if (rv.has_value() && end != semicolon)
+	{
+		error = ErrorMismatch(end, HE_TOKEN_SEMICOLON);
+		return {};
+	}
+	end = semicolon + 1;
 	return rv;
 }
 
@@ -820,11 +949,56 @@ bool AST::Parse(const vector<Token>& tokens)
 		exprs = v.value();
 	}
 	else {
+		error_token = parser.ErrorToken();
 		return false;
 	}
 	return true;
 }
 
+bool AST::ParseEntry(const vector<Token>& tokens, const string& name)
+{
+	error = "";
+	ASTParser parser(tokens);
+	if (auto v = parser.ParseEntry(name, error); v.has_value()) {
+		exprs = v.value();
+	}
+	else {
+		error_token = parser.ErrorToken();
+		return false;
+	}
+	return true;
+}
+
+void AST::Import(const vector<ptr<SignatureExpr>>& sigs)
+{
+	he_assert(exprs != nullptr);
+	exprs->Import(sigs);
+}
+
+const vector<Token>& AST::Imports()
+{
+	he_assert(exprs != nullptr);
+	return exprs->Imports();
+}
+
+const vector<ptr<FuncExpr>>& AST::Functions()
+{
+	he_assert(exprs != nullptr);
+	return exprs->Functions();
+}
+
+void AST::Retain(const unordered_set<string>& names)
+{
+	he_assert(exprs != nullptr);
+	exprs->Retain(names);
+}
+
+void AST::Signatures(vector<ptr<SignatureExpr>>& defined, vector<ptr<SignatureExpr>>& declared)
+{
+	he_assert(exprs != nullptr);
+	exprs->Signatures(defined, declared);
+}
+
 string  AST::ErrorMsg() 
 {
 	return error;
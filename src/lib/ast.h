@@ -2,6 +2,7 @@
 #include "common.h"
 #include "tokens.h"
 #include "llvm/IR/IRBuilder.h"
+#include <unordered_set>
 
 
 struct Declearation 
@@ -20,9 +21,13 @@ struct Declearation
 //expr  ::= prim [op prim]* 
 //call  ::= id([expr[,expr]*])
 //body  ::= { [expr[;expr]*] }
-//func  ::= fn id([id id[,id id]*]) body
+//func  ::= [multiversion] fn id([id id[,id id]*]) body
 //top   ::= [func]*
 
+class CallExpr;
+struct BytecodeBuilder;
+struct BytecodeProgram;
+
 //every ast object should be derived from this class
 class Expr 
 {
@@ -32,9 +37,18 @@ class Expr
 public:
 	virtual ~Expr() {}
 	virtual optional<llvm::Value*> CodeGenerate(string& error) = 0;
+	//collect every call expression under this node,used by the specialization pass
+	virtual void CollectCalls(vector<CallExpr*>& calls) {}
+	//compile to the interpreter's bytecode,returns the register holding the value
+	virtual optional<u32> BytecodeGenerate(BytecodeBuilder& builder, string& error);
 
 	Expr(Token& token) :line(token.line), start(token.start), end(token.end) {}
+	u32 GetLine() { return line; }
+	u32 GetStart() { return start; }
+	u32 GetEnd() { return end; }
 	string ErrorPrefix();
+	//(line:start-end) of the token this expression starts at
+	string Location();
 };
 
 //currently we only support unsigned numbers
@@ -45,6 +59,9 @@ class NumberExpr : public Expr
 public:
 	NumberExpr(string number,Token& token):num(number),Expr(token) {}
 	virtual optional<llvm::Value*> CodeGenerate(string& error) override;
+	virtual optional<u32> BytecodeGenerate(BytecodeBuilder& builder, string& error) override;
+
+	const string& GetNumber() { return num; }
 };
 
 //var   ::= id
@@ -57,6 +74,9 @@ public:
 		he_assert(!name.empty());
 	}
 	virtual optional<llvm::Value*> CodeGenerate(string& error) override;
+	virtual optional<u32> BytecodeGenerate(BytecodeBuilder& builder, string& error) override;
+
+	const string& GetName() { return name; }
 };
 
 //expr  ::= prim [op prim]* 
@@ -71,6 +91,8 @@ public:
 		he_assert(lhs != nullptr && rhs != nullptr);
 	}
 	virtual optional<llvm::Value*> CodeGenerate(string& error) override;
+	virtual void CollectCalls(vector<CallExpr*>& calls) override;
+	virtual optional<u32> BytecodeGenerate(BytecodeBuilder& builder, string& error) override;
 };
 
 //call  ::= id([expr[,expr]*])
@@ -78,9 +100,19 @@ class CallExpr : public Expr
 {
 	string func;
 	vector<ptr<Expr>> args;
+	//the call is in tail position of the function being generated
+	bool tail = false;
 public:
 	CallExpr(const string& func, vector<ptr<Expr>>& args,Token& token) :func(func), args(args),Expr(token) {}
 	virtual optional<llvm::Value*> CodeGenerate(string& error) override;
+	virtual void CollectCalls(vector<CallExpr*>& calls) override;
+	virtual optional<u32> BytecodeGenerate(BytecodeBuilder& builder, string& error) override;
+
+	const string& GetFunc() { return func; }
+	const vector<ptr<Expr>>& GetArgs() { return args; }
+	//point this call to another function with a new argument list
+	void Redirect(const string& func, const vector<ptr<Expr>>& args) { this->func = func; this->args = args; }
+	void MarkTail() { tail = true; }
 };
 
 //assign ::=  id = expr;
@@ -91,6 +123,11 @@ public:
 	AssignExpr(ptr<Expr> expr,const string& name,Token& token):Expr(token),expr(expr),name(name) {}
 	//return nullptr if success,return nullopt if fails
 	virtual optional<llvm::Value*> CodeGenerate(string& error) override;
+	virtual void CollectCalls(vector<CallExpr*>& calls) override;
+	virtual optional<u32> BytecodeGenerate(BytecodeBuilder& builder, string& error) override;
+
+	const string& GetName() { return name; }
+	ptr<Expr> GetExpr() { return expr; }
 };
 
 //declear ::= [mut] id assign
@@ -103,6 +140,8 @@ public:
 	type(type),name(name),mut(mut),assign(expr) {}
 	//return nullptr if success,return nullopt if fail
 	virtual optional<llvm::Value*> CodeGenerate(string& error) override;
+	virtual void CollectCalls(vector<CallExpr*>& calls) override;
+	virtual optional<u32> BytecodeGenerate(BytecodeBuilder& builder, string& error) override;
 };
 
 class SignatureExpr : public Expr {
@@ -115,8 +154,14 @@ public:
 	return_type(rt),name(name),args(args),Expr(token) {}
 
 	string GetName() {return name;}
+	//name of the generated function,main is renamed to the entry of the runtime
+	string LinkName();
+	//argument and return types,(i32,i32,)->i32,two signatures with the same key are compatible
+	string TypeKey();
 	string GetReturnType() { return return_type; }
 	const vector<Declearation>& GetArgs() { return args; }
+	//copy of this signature under a new name with a new argument list
+	ptr<SignatureExpr> Clone(const string& name, const vector<Declearation>& args);
 };
 
 
@@ -128,9 +173,19 @@ public:
 	BodyExpr(const vector<ptr<Expr>>& body, ptr<Expr> rt_expr, Token& token):body(body),rt_expr(rt_expr),Expr(token){}
 	
 	virtual optional<llvm::Value*> CodeGenerate(string& error) override;
+	virtual void CollectCalls(vector<CallExpr*>& calls) override;
 	
-	bool GenerateBodyCode(string& error,bool generate_return);
+	//the value of the returned expression is kept in rt_value if given
+	bool GenerateBodyCode(string& error,bool generate_return,llvm::Value** rt_value = nullptr);
+	bool GenerateBodyBytecode(BytecodeBuilder& builder, string& error, bool generate_return);
 	bool HasReturnValue() { return rt_expr != nullptr; }
+
+	//calls in tail position of a function body: the returned expression itself,or a call
+	//assigned to the returned variable as the last statement of a branch of the if expression
+	//right before the return
+	void CollectTailCalls(vector<CallExpr*>& calls);
+	//calls assigned to var as the last statement of this branch body
+	void CollectAssignedTailCalls(const string& var, vector<CallExpr*>& calls);
 };
 
 //ifexpr ::= if ( expr ) { body } [else {body} ]
@@ -146,6 +201,10 @@ public:
 		then_expr(then_expr), else_expr(else_expr), cond(cond),Expr(token),
 	elif_expr(elif_expr),elif_cond_expr(elif_cond_expr) {}
 	virtual optional<llvm::Value*> CodeGenerate(string& error) override;
+	virtual void CollectCalls(vector<CallExpr*>& calls) override;
+	virtual optional<u32> BytecodeGenerate(BytecodeBuilder& builder, string& error) override;
+
+	void CollectTailCalls(const string& var, vector<CallExpr*>& calls);
 };
 
 //body  ::= [expr|assign|declear[;expr|assign|declear|nil]*] 
@@ -154,37 +213,92 @@ class FuncExpr : public Expr
 {
 	ptr<SignatureExpr> signature;
 	ptr<BodyExpr> body;
+	//arguments bound to literals by call-site specialization,pairs of (name,number)
+	vector<pair<string, string>> constant_args;
+	//compile a clone per micro-architecture level and dispatch to the best one at load time
+	bool multiversion = false;
+	//a repl entry,returns the value of its body zero extended to u8 whatever its type
+	bool echo = false;
+	//hash of the tokens of the definition,set by the parser
+	u64 hash = 0;
 public:
 	FuncExpr(ptr<SignatureExpr> signature,ptr<BodyExpr> body,Token& token):
 		signature(signature),body(body), Expr(token) {}
 	virtual optional<llvm::Value*> CodeGenerate(string& error) override;
+	virtual void CollectCalls(vector<CallExpr*>& calls) override;
 
 	optional<llvm::Function*> FunctionSignatureGenerate(string& error);
 	bool FunctionBodyGenerate(string& error);
+	bool FunctionBytecodeGenerate(BytecodeBuilder& builder, string& error);
+
+	ptr<SignatureExpr> GetSignature() { return signature; }
+	bool IsSpecialization() { return !constant_args.empty(); }
+	void MarkMultiversion() { multiversion = true; }
+	bool IsMultiversion() { return multiversion; }
+	void MarkEcho() { echo = true; }
+	void SetHash(u64 h) { hash = h; }
+	u64  GetHash() { return hash; }
+	bool IsEcho() { return echo; }
+	//calls in tail position of the body,none for a void or echo function
+	void CollectTailCalls(vector<CallExpr*>& calls);
+	//clone this function with the arguments whose binding has a value replaced by constants
+	//the clone shares the body with the original function
+	ptr<FuncExpr> Specialize(const string& name, const vector<optional<string>>& binding);
 };
 
-//top   ::= [func]*
+//top   ::= [import | extern | func]*
 class TopLevelExpr : public Expr 
 {
 	vector<ptr<FuncExpr>> funcs;
 	vector<ptr<SignatureExpr>> extern_funcs;
+	//the identifier tokens of the imported modules
+	vector<Token> imports;
 public:
 	TopLevelExpr(const vector<ptr<FuncExpr>>& funcs,
 		vector<ptr<SignatureExpr>>& extern_funcs,
-		Token& token):funcs(funcs),extern_funcs(extern_funcs), Expr(token) {}
+		Token& token, const vector<Token>& imports = {}):funcs(funcs),extern_funcs(extern_funcs),imports(imports), Expr(token) {}
 
 	virtual optional<llvm::Value*> CodeGenerate(string& error) override;
 	optional<string> IRGenerate(string& error);
+	//clone functions called with literal arguments and redirect the calls to the clones
+	//at most limit clones are created for every function,the clones are listed in report if given
+	void Specialize(u32 limit, string* report);
+	//declare functions of other modules unless this one defines or declares them itself
+	void Import(const vector<ptr<SignatureExpr>>& sigs);
+	//signatures of the functions defined and the extern functions declared in this file
+	void Signatures(vector<ptr<SignatureExpr>>& defined, vector<ptr<SignatureExpr>>& declared);
+	const vector<ptr<FuncExpr>>& Functions() { return funcs; }
+	const vector<Token>& Imports() { return imports; }
+	//drop the functions whose names aren't in names,extern declarations are kept
+	void Retain(const unordered_set<string>& names);
+
+	//register the functions of this file in the program,then compile their bodies once every
+	//file is declared so calls across files resolve to bytecode functions
+	bool BytecodeDeclare(BytecodeProgram& program, u32 file, string& error);
+	bool BytecodeDefine(BytecodeProgram& program, u32 file, string& error);
 };
 
 class AST 
 {
 public:
 	bool Parse(const vector<Token>& tokens);
+	//parse a repl entry,either functions and extern declarations or statements,which are
+	//wrapped in an echo function called name
+	bool ParseEntry(const vector<Token>& tokens, const string& name);
+	void Import(const vector<ptr<SignatureExpr>>& sigs);
+	void Signatures(vector<ptr<SignatureExpr>>& defined, vector<ptr<SignatureExpr>>& declared);
+	const vector<Token>& Imports();
+	const vector<ptr<FuncExpr>>& Functions();
+	void Retain(const unordered_set<string>& names);
 	optional<string> GenerateIRCode();
+	bool DeclareBytecode(BytecodeProgram& program, u32 file);
+	bool GenerateBytecode(BytecodeProgram& program, u32 file);
 	
 	string ErrorMsg();
+	//token a parse error is reported at
+	const optional<Token>& ErrorToken() { return error_token; }
 private:
 	 ptr<TopLevelExpr> exprs;
 	 string error;
+	 optional<Token> error_token;
 };
@@ -0,0 +1,200 @@
+#include "builddb.h"
+#include "ast.h"
+#include "interface.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+u64 HashContent(const string& content, u64 hash) {
+	for (unsigned char c : content) {
+		hash = (hash ^ c) * 1099511628211ull;
+	}
+	return hash;
+}
+
+string FileStamp(const string& path) {
+	std::error_code EC;
+	auto size = fs::file_size(path, EC);
+	if (EC) {
+		return "";
+	}
+	auto time = fs::last_write_time(path, EC);
+	if (EC) {
+		return "";
+	}
+	return to_string(size) + ":" + to_string(time.time_since_epoch().count());
+}
+
+void RecordSignatures(AST& ast, const string& path, BuildFile& file) {
+	vector<ptr<SignatureExpr>> defined, declared;
+	ast.Signatures(defined, declared);
+	file.defined.clear();
+	file.declared.clear();
+	for (auto& s : defined) {
+		file.defined[s->GetName()] = s->TypeKey();
+	}
+	for (auto& s : declared) {
+		file.declared[s->GetName()] = s->TypeKey();
+	}
+	file.imports.clear();
+	for (auto& t : ast.Imports()) {
+		string source = ModuleSource(path, t.token), error;
+		if (auto sigs = LoadInterface(source, false, error); sigs.has_value()) {
+			file.imports[source] = InterfaceDigest(sigs.value());
+		}
+	}
+}
+
+string ChangedImport(const BuildFile& file) {
+	for (auto& [source, digest] : file.imports) {
+		string error;
+		auto sigs = LoadInterface(source, false, error);
+		if (!sigs.has_value() || InterfaceDigest(sigs.value()) != digest) {
+			return source;
+		}
+	}
+	return "";
+}
+
+static string ObjectPath(const string& dir, const string& path, u32 k) {
+	char key[32];
+	snprintf(key, sizeof(key), "%016llx", (unsigned long long)HashContent(path));
+	return (fs::path(dir) / (string(key) + "." + to_string(k) + ".o")).string();
+}
+
+optional<BuildRecord> LoadBuildRecord(const string& dir) {
+	ifstream in(fs::path(dir) / "db");
+	string line;
+	if (!in || !getline(in, line) || line != "helang-build 1") {
+		return {};
+	}
+	BuildRecord record;
+	BuildFile* file = nullptr;
+	while (getline(in, line)) {
+		usize space = line.find(' ');
+		string kind = line.substr(0, space), rest = space == string::npos ? "" : line.substr(space + 1);
+		if (kind == "options") {
+			record.options = rest;
+		}
+		else if (kind == "output") {
+			record.output_stamp = rest;
+		}
+		else if (kind == "input") {
+			record.order.push_back(rest);
+		}
+		else if (kind == "file") {
+			//file <hash> <objects> <path>,the path may contain spaces
+			stringstream ss(rest);
+			u64 hash;
+			u32 objects;
+			if (!(ss >> hex >> hash >> dec >> objects)) {
+				return {};
+			}
+			string path;
+			getline(ss >> ws, path);
+			file = &record.files[path];
+			file->hash = hash;
+			file->objects = objects;
+		}
+		else if ((kind == "def" || kind == "decl") && file != nullptr) {
+			usize p = rest.find(' ');
+			if (p == string::npos) {
+				return {};
+			}
+			(kind == "def" ? file->defined : file->declared)[rest.substr(0, p)] = rest.substr(p + 1);
+		}
+		else if (kind == "import" && file != nullptr) {
+			//import <digest> <path>
+			stringstream ss(rest);
+			u64 digest;
+			if (!(ss >> hex >> digest)) {
+				return {};
+			}
+			string path;
+			getline(ss >> ws, path);
+			file->imports[path] = digest;
+		}
+		else {
+			return {};
+		}
+	}
+	return record;
+}
+
+bool SaveBuildRecord(const string& dir, const BuildRecord& record, string& error) {
+	std::error_code EC;
+	fs::create_directories(dir, EC);
+	//a build stopped while writing leaves the old database
+	fs::path path = fs::path(dir) / "db", temp = fs::path(dir) / "db.tmp";
+	{
+		ofstream out(temp);
+		if (!out) {
+			error = "can't write the build database " + temp.string();
+			return false;
+		}
+		out << "helang-build 1\n";
+		out << "options " << record.options << "\n";
+		out << "output " << record.output_stamp << "\n";
+		for (auto& p : record.order) {
+			out << "input " << p << "\n";
+		}
+		for (auto& [p, f] : record.files) {
+			out << "file " << hex << f.hash << dec << " " << f.objects << " " << p << "\n";
+			for (auto& [name, key] : f.defined) {
+				out << "def " << name << " " << key << "\n";
+			}
+			for (auto& [name, key] : f.declared) {
+				out << "decl " << name << " " << key << "\n";
+			}
+			for (auto& [source, digest] : f.imports) {
+				out << "import " << hex << digest << dec << " " << source << "\n";
+			}
+		}
+		if (!out) {
+			error = "can't write the build database " + temp.string();
+			return false;
+		}
+	}
+	fs::rename(temp, path, EC);
+	if (EC) {
+		error = "can't write the build database " + path.string();
+		return false;
+	}
+	return true;
+}
+
+optional<vector<vector<char>>> LoadBuildObjects(const string& dir, const string& path, u32 count) {
+	vector<vector<char>> objects;
+	for (u32 k = 0; k < count; k++) {
+		ifstream in(ObjectPath(dir, path, k), ios::binary);
+		if (!in) {
+			return {};
+		}
+		objects.emplace_back(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+	}
+	return objects;
+}
+
+bool SaveBuildObjects(const string& dir, const string& path, const vector<vector<char>>& objects, string& error) {
+	std::error_code EC;
+	fs::create_directories(dir, EC);
+	for (u32 k = 0; k < objects.size(); k++) {
+		string name = ObjectPath(dir, path, k);
+		ofstream out(name, ios::binary);
+		out.write(objects[k].data(), objects[k].size());
+		if (!out) {
+			error = "can't write " + name;
+			return false;
+		}
+	}
+	return true;
+}
+
+void RemoveBuildObjects(const string& dir, const string& path, u32 count) {
+	std::error_code EC;
+	for (u32 k = 0; k < count; k++) {
+		fs::remove(ObjectPath(dir, path, k), EC);
+	}
+}
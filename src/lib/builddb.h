@@ -0,0 +1,51 @@
+#pragma once
+#include "common.h"
+#include <map>
+
+class AST;
+
+//build database of the helang driver,the directory <output>.hedb next to the executable
+//it keeps the objects of every input so a rebuild compiles only the inputs that changed
+//  db           helang-build 1,the options the objects were compiled with,the stamp of the
+//               executable of the last link and the inputs in link order,then per input its
+//               content hash,object count,path,the signatures it defines and declares and the
+//               digest of the interface of every module it imports
+//  <key>.<k>.o  object k of the input whose path hashes to key
+
+struct BuildFile
+{
+	u64 hash = 0;
+	u32 objects = 0;
+	//function name to SignatureExpr::TypeKey
+	map<string, string> defined, declared;
+	//source of an imported module to the digest of its interface,the file is compiled again
+	//when one changes
+	map<string, u64> imports;
+};
+
+struct BuildRecord
+{
+	string options;
+	string output_stamp;
+	vector<string> order;
+	//by absolute path
+	map<string, BuildFile> files;
+};
+
+//hash continues an earlier one,so a source can be hashed a line at a time
+u64 HashContent(const string& content, u64 hash = 14695981039346656037ull);
+//size and write time of a file,empty if it doesn't exist
+string FileStamp(const string& path);
+//the signatures of the functions the ast of the file at path defines and declares with ccnd or
+//imports,and the interfaces it imports
+void RecordSignatures(AST& ast, const string& path, BuildFile& file);
+//the first module file imports whose interface isn't the one it was compiled with,empty if none
+string ChangedImport(const BuildFile& file);
+
+//returns nothing if there is no database or it can't be read
+optional<BuildRecord> LoadBuildRecord(const string& dir);
+bool SaveBuildRecord(const string& dir, const BuildRecord& record, string& error);
+//returns nothing if an object is missing
+optional<vector<vector<char>>> LoadBuildObjects(const string& dir, const string& path, u32 count);
+bool SaveBuildObjects(const string& dir, const string& path, const vector<vector<char>>& objects, string& error);
+void RemoveBuildObjects(const string& dir, const string& path, u32 count);
@@ -0,0 +1,382 @@
+#include "ast.h"
+#include "bytecode.h"
+
+//bytecode generation
+//the ast has already been turned into llvm ir when it is compiled to bytecode,so the program is
+//known to be well formed and the specialization pass and the tail call marks are reused
+
+HE_VALUE_TYPE BytecodeProgram::ValueType(const string& type)
+{
+	if (type == "i32") return HE_VALUE_I32;
+	if (type == "u8") return HE_VALUE_I64;
+	return HE_VALUE_VOID;
+}
+
+u32 BytecodeBuilder::NewReg(HE_VALUE_TYPE type)
+{
+	//registers are addressed by 16 bit operands
+	if (types.size() >= 0xffff)
+	{
+		overflow = true;
+		return 0;
+	}
+	types.push_back(type);
+	mut_regs.push_back(0);
+	return types.size() - 1;
+}
+
+u32 BytecodeBuilder::Emit(HE_OP op, u32 a, u32 b, u32 c)
+{
+	func->code.push_back(Instr{ (u16)op, (u16)a, (u16)b, (u16)c });
+	return func->code.size() - 1;
+}
+
+u32 BytecodeBuilder::EmitImm(HE_OP op, u32 a, u32 imm)
+{
+	return Emit(op, a, imm & 0xffff, imm >> 16);
+}
+
+void BytecodeBuilder::PatchImm(u32 at, u32 imm)
+{
+	func->code[at].b = imm & 0xffff;
+	func->code[at].c = imm >> 16;
+}
+
+optional<u32> BytecodeBuilder::ResolveCall(const string& name, bool& is_extern)
+{
+	is_extern = false;
+	if (auto v = program.func_index.find(to_string(file) + ":" + name); v != program.func_index.end())
+	{
+		return v->second;
+	}
+	if (auto v = program.func_index.find(name); v != program.func_index.end())
+	{
+		return v->second;
+	}
+	if (auto v = program.extern_index.find(name); v != program.extern_index.end())
+	{
+		is_extern = true;
+		return v->second;
+	}
+	return {};
+}
+
+optional<u32> Expr::BytecodeGenerate(BytecodeBuilder& builder, string& error)
+{
+	error = "expression at " + Location() + " can't be compiled to bytecode";
+	return {};
+}
+
+optional<u32> NumberExpr::BytecodeGenerate(BytecodeBuilder& builder, string& error)
+{
+	u32 reg = builder.NewReg(HE_VALUE_I32);
+	builder.EmitImm(HE_OP_LOADK, reg, (u32)stoi(num));
+	return reg;
+}
+
+optional<u32> VariableExpr::BytecodeGenerate(BytecodeBuilder& builder, string& error)
+{
+	if (auto v = builder.vars.find(name); v != builder.vars.end())
+	{
+		return v->second;
+	}
+	error = "undefined variable " + name + " at " + Location();
+	return {};
+}
+
+optional<u32> CalculateExpr::BytecodeGenerate(BytecodeBuilder& builder, string& error)
+{
+	auto l = lhs->BytecodeGenerate(builder, error);
+	if (!l.has_value()) return {};
+	auto r = rhs->BytecodeGenerate(builder, error);
+	if (!r.has_value()) return {};
+
+	//the operands have the same type,otherwise the llvm ir would not have been verified
+	bool wide = builder.types[l.value()] == HE_VALUE_I64;
+	HE_OP code;
+	HE_VALUE_TYPE type = wide ? HE_VALUE_I64 : HE_VALUE_I32;
+	if (op == "+") code = wide ? HE_OP_ADD64 : HE_OP_ADD32;
+	else if (op == "-") code = wide ? HE_OP_SUB64 : HE_OP_SUB32;
+	else if (op == "*") code = wide ? HE_OP_MUL64 : HE_OP_MUL32;
+	else if (op == "/") code = wide ? HE_OP_DIV64 : HE_OP_DIV32;
+	else if (op == "==") code = HE_OP_EQ, type = HE_VALUE_I1;
+	else if (op == "!=") code = HE_OP_NE, type = HE_VALUE_I1;
+	else if (op == "|")
+	{
+		//(lhs << 8) in the type of lhs,then both sides zero extended to 64 bit
+		u32 shifted = builder.NewReg(HE_VALUE_I64);
+		builder.Emit(wide ? HE_OP_SHL8_64 : HE_OP_SHL8_32, shifted, l.value());
+		u32 reg = builder.NewReg(HE_VALUE_I64);
+		builder.Emit(HE_OP_OR, reg, shifted, r.value());
+		return reg;
+	}
+	else
+	{
+		error = "unknown operator " + op + " at " + Location();
+		return {};
+	}
+
+	u32 reg = builder.NewReg(type);
+	builder.Emit(code, reg, l.value(), r.value());
+	return reg;
+}
+
+optional<u32> CallExpr::BytecodeGenerate(BytecodeBuilder& builder, string& error)
+{
+	bool is_extern;
+	auto callee = builder.ResolveCall(func, is_extern);
+	if (!callee.has_value())
+	{
+		error = "function " + func + " called at " + Location() + " is not defined";
+		return {};
+	}
+	HE_VALUE_TYPE ret_type;
+	if (is_extern)
+	{
+		builder.program.externs[callee.value()].used = true;
+		ret_type = builder.program.externs[callee.value()].ret_type;
+	}
+	else
+	{
+		ret_type = builder.program.funcs[callee.value()]->ret_type;
+	}
+
+	vector<u32> values;
+	for (auto& arg : args)
+	{
+		auto v = arg->BytecodeGenerate(builder, error);
+		if (!v.has_value()) return {};
+		values.push_back(v.value());
+	}
+
+	//the result register comes before the argument block,which the callee's frame overlaps
+	u32 dst = builder.NewReg(ret_type);
+	u32 base = builder.types.size();
+	for (u32 v : values)
+	{
+		u32 reg = builder.NewReg(builder.types[v]);
+		builder.Emit(HE_OP_MOV, reg, v);
+	}
+
+	if (is_extern)
+	{
+		builder.Emit(HE_OP_CALLX, dst, callee.value(), base);
+	}
+	else if (tail && callee.value() == builder.func_index)
+	{
+		builder.Emit(HE_OP_TAILSELF, 0, base);
+	}
+	else if (tail)
+	{
+		builder.Emit(HE_OP_TAILCALL, 0, callee.value(), base);
+	}
+	else
+	{
+		builder.Emit(HE_OP_CALL, dst, callee.value(), base);
+	}
+	return dst;
+}
+
+optional<u32> AssignExpr::BytecodeGenerate(BytecodeBuilder& builder, string& error)
+{
+	auto v = expr->BytecodeGenerate(builder, error);
+	if (!v.has_value()) return {};
+	auto var = builder.vars.find(name);
+	if (var == builder.vars.end() || !builder.mut_regs[var->second])
+	{
+		error = "undefined variable " + name + " at " + Location();
+		return {};
+	}
+	builder.Emit(HE_OP_MOV, var->second, v.value());
+	return var->second;
+}
+
+optional<u32> DeclearExpr::BytecodeGenerate(BytecodeBuilder& builder, string& error)
+{
+	optional<u32> value;
+	if (assign != nullptr)
+	{
+		value = assign->BytecodeGenerate(builder, error);
+		if (!value.has_value()) return {};
+	}
+
+	//a constant takes the register of its value unless that is a variable updated later
+	if (!mut && !builder.mut_regs[value.value()])
+	{
+		builder.vars[name] = value.value();
+		return value;
+	}
+
+	u32 reg = builder.NewReg(BytecodeProgram::ValueType(type));
+	if (value.has_value())
+	{
+		builder.Emit(HE_OP_MOV, reg, value.value());
+	}
+	else
+	{
+		builder.EmitImm(HE_OP_LOADK, reg, 0);
+	}
+	builder.mut_regs[reg] = mut;
+	builder.vars[name] = reg;
+	return reg;
+}
+
+optional<u32> IfExpr::BytecodeGenerate(BytecodeBuilder& builder, string& error)
+{
+	vector<ptr<Expr>> conds{ cond };
+	vector<ptr<BodyExpr>> bodies{ then_expr };
+	conds.insert(conds.end(), elif_cond_expr.begin(), elif_cond_expr.end());
+	bodies.insert(bodies.end(), elif_expr.begin(), elif_expr.end());
+
+	vector<u32> to_end;
+	for (u32 i = 0; i < conds.size(); i++)
+	{
+		auto c = conds[i]->BytecodeGenerate(builder, error);
+		if (!c.has_value()) return {};
+		u32 skip = builder.EmitImm(HE_OP_JZ, c.value(), 0);
+		if (!bodies[i]->GenerateBodyBytecode(builder, error, false))
+		{
+			return {};
+		}
+		to_end.push_back(builder.EmitImm(HE_OP_JMP, 0, 0));
+		builder.PatchImm(skip, builder.Here());
+	}
+	if (else_expr != nullptr && !else_expr->GenerateBodyBytecode(builder, error, false))
+	{
+		return {};
+	}
+	for (u32 at : to_end)
+	{
+		builder.PatchImm(at, builder.Here());
+	}
+	return 0;
+}
+
+bool BodyExpr::GenerateBodyBytecode(BytecodeBuilder& builder, string& error, bool generate_return)
+{
+	for (auto& expr : body)
+	{
+		if (!expr->BytecodeGenerate(builder, error).has_value())
+		{
+			return false;
+		}
+	}
+	if (rt_expr != nullptr)
+	{
+		auto v = rt_expr->BytecodeGenerate(builder, error);
+		if (!v.has_value()) return false;
+		if (generate_return)
+		{
+			builder.Emit(HE_OP_RET, v.value());
+		}
+	}
+	return true;
+}
+
+bool FuncExpr::FunctionBytecodeGenerate(BytecodeBuilder& builder, string& error)
+{
+	BytecodeFunction* func = builder.func;
+	builder.vars.clear();
+	builder.mut_regs.clear();
+	builder.types.clear();
+
+	for (auto& arg : signature->GetArgs())
+	{
+		builder.vars[arg.name] = builder.NewReg(BytecodeProgram::ValueType(arg.type));
+	}
+	for (auto& [name, num] : constant_args)
+	{
+		u32 reg = builder.NewReg(HE_VALUE_I32);
+		builder.EmitImm(HE_OP_LOADK, reg, (u32)stoi(num));
+		builder.vars[name] = reg;
+	}
+
+	if (!body->GenerateBodyBytecode(builder, error, true))
+	{
+		error = "fail to generate bytecode at function " + signature->GetName() + " : " + error;
+		return false;
+	}
+	if (!body->HasReturnValue())
+	{
+		if (func->ret_type == HE_VALUE_VOID)
+		{
+			builder.Emit(HE_OP_RETV);
+		}
+		else
+		{
+			u32 reg = builder.NewReg(func->ret_type);
+			builder.EmitImm(HE_OP_LOADK, reg, 0);
+			builder.Emit(HE_OP_RET, reg);
+		}
+	}
+	if (builder.overflow)
+	{
+		error = "function " + signature->GetName() + " has too many values to be interpreted";
+		return false;
+	}
+	func->regs = builder.types.size();
+	return true;
+}
+
+bool TopLevelExpr::BytecodeDeclare(BytecodeProgram& program, u32 file, string& error)
+{
+	for (auto& f : funcs)
+	{
+		ptr<SignatureExpr> sig = f->GetSignature();
+		string key = f->IsSpecialization() ? to_string(file) + ":" + sig->GetName() : sig->GetName();
+		if (program.func_index.count(key))
+		{
+			error = "function " + sig->GetName() + " is defined more than once";
+			return false;
+		}
+		unique_ptr<BytecodeFunction> func = make_unique<BytecodeFunction>();
+		func->name = sig->GetName();
+		//specialized clones are renamed per file before the modules are added to the jit
+		func->jit_name = f->IsSpecialization() ? sig->GetName() + ".m" + to_string(file) : sig->GetName();
+		func->args = sig->GetArgs().size();
+		func->ret_type = BytecodeProgram::ValueType(sig->GetReturnType());
+		program.func_index[key] = program.funcs.size();
+		program.funcs.push_back(std::move(func));
+	}
+	for (auto& sig : extern_funcs)
+	{
+		if (program.extern_index.count(sig->GetName()))
+		{
+			continue;
+		}
+		BytecodeExtern ext;
+		ext.name = sig->GetName();
+		ext.args = sig->GetArgs().size();
+		ext.ret_type = BytecodeProgram::ValueType(sig->GetReturnType());
+		program.extern_index[ext.name] = program.externs.size();
+		program.externs.push_back(ext);
+	}
+	return true;
+}
+
+bool TopLevelExpr::BytecodeDefine(BytecodeProgram& program, u32 file, string& error)
+{
+	BytecodeBuilder builder(program, file);
+	for (auto& f : funcs)
+	{
+		string name = f->GetSignature()->GetName();
+		string key = f->IsSpecialization() ? to_string(file) + ":" + name : name;
+		builder.func_index = program.func_index[key];
+		builder.func = program.funcs[builder.func_index].get();
+		if (!f->FunctionBytecodeGenerate(builder, error))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool AST::DeclareBytecode(BytecodeProgram& program, u32 file)
+{
+	return exprs != nullptr && exprs->BytecodeDeclare(program, file, error);
+}
+
+bool AST::GenerateBytecode(BytecodeProgram& program, u32 file)
+{
+	return exprs != nullptr && exprs->BytecodeDefine(program, file, error);
+}
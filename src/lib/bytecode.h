@@ -0,0 +1,113 @@
+#pragma once
+#include "common.h"
+#include <atomic>
+#include <unordered_map>
+
+//tier 0 of helang-c --run
+//functions are compiled from the ast to a register based bytecode,a call passes its arguments
+//in a block of consecutive registers at the end of the caller's frame and the callee's frame
+//starts at that block,so the arguments are in place without being copied
+
+enum HE_VALUE_TYPE : u8 {
+	HE_VALUE_VOID,
+	HE_VALUE_I1,
+	HE_VALUE_I32,
+	//u8 of helang,which is 64 bit wide
+	HE_VALUE_I64,
+};
+
+#define HE_BYTECODE_OPS(X) \
+	X(LOADK)    /*a = imm*/ \
+	X(MOV)      /*a = b*/ \
+	X(ADD32) X(SUB32) X(MUL32) X(DIV32) \
+	X(ADD64) X(SUB64) X(MUL64) X(DIV64) \
+	X(EQ) X(NE) \
+	X(SHL8_32)  /*a = (u32)(b << 8)*/ \
+	X(SHL8_64)  /*a = b << 8*/ \
+	X(OR)       /*a = b | c*/ \
+	X(JMP)      /*pc = imm*/ \
+	X(JZ)       /*if a == 0,pc = imm*/ \
+	X(CALL)     /*a = funcs[b](c...)*/ \
+	X(CALLX)    /*a = externs[b](c...)*/ \
+	X(TAILSELF) /*restart the function with the arguments in b...*/ \
+	X(TAILCALL) /*replace the frame by funcs[b](c...)*/ \
+	X(RET)      /*return a*/ \
+	X(RETV)
+
+enum HE_OP : u16 {
+#define HE_OP_ENUM(name) HE_OP_##name,
+	HE_BYTECODE_OPS(HE_OP_ENUM)
+#undef HE_OP_ENUM
+	HE_OP_COUNT
+};
+
+//i32 values are kept zero extended in 64 bit registers,imm is the 32 bit value b | c << 16
+struct Instr {
+	u16 op, a, b, c;
+
+	u32 Imm() const { return (u32)b | ((u32)c << 16); }
+};
+
+struct BytecodeFunction {
+	string name;
+	//symbol of the llvm function,looked up when the function is promoted to the jit
+	string jit_name;
+	u32    args = 0;
+	u32    regs = 0;
+	HE_VALUE_TYPE ret_type = HE_VALUE_VOID;
+	vector<Instr> code;
+
+	//entries and back edges,the function is promoted once it reaches the tier threshold
+	u32    hotness = 0;
+	//compiled code swapped in by the tier-up thread,called instead of the bytecode from then on
+	atomic<void*> native{ nullptr };
+};
+
+//a ccnd function,called through the ffi thunk of its arity
+struct BytecodeExtern {
+	string name;
+	u32    args = 0;
+	HE_VALUE_TYPE ret_type = HE_VALUE_VOID;
+	bool   used = false;
+	void*  addr = nullptr;
+};
+
+struct BytecodeProgram {
+	vector<unique_ptr<BytecodeFunction>> funcs;
+	vector<BytecodeExtern> externs;
+	//functions by name,specialized clones are local to their file and keyed by file:name
+	unordered_map<string, u32> func_index;
+	unordered_map<string, u32> extern_index;
+
+	static HE_VALUE_TYPE ValueType(const string& type);
+};
+
+//state of the function being compiled to bytecode
+struct BytecodeBuilder {
+	BytecodeProgram& program;
+	u32 file;
+	u32 func_index = 0;
+	BytecodeFunction* func = nullptr;
+	//registers of arguments and variables,mut variables are updated in place
+	unordered_map<string, u32> vars;
+	vector<u8> mut_regs;
+	vector<HE_VALUE_TYPE> types;
+	bool overflow = false;
+
+	BytecodeBuilder(BytecodeProgram& program, u32 file) :program(program), file(file) {}
+
+	u32  NewReg(HE_VALUE_TYPE type);
+	u32  Emit(HE_OP op, u32 a = 0, u32 b = 0, u32 c = 0);
+	u32  EmitImm(HE_OP op, u32 a, u32 imm);
+	void PatchImm(u32 at, u32 imm);
+	u32  Here() { return func->code.size(); }
+	//index into program.funcs,or into program.externs when is_extern is set
+	optional<u32> ResolveCall(const string& name, bool& is_extern);
+};
+
+struct Config;
+struct LLVMCodeGenContext;
+//run __he_entry_main in the interpreter,with tiering hot functions are compiled by a jit built
+//from the modules on a background thread and the modules are moved into that jit
+optional<int> RunBytecode(BytecodeProgram& program, vector<ptr<LLVMCodeGenContext>>& modules,
+	Config& config, string& error);
@@ -0,0 +1,172 @@
+#include "server.h"
+#include <cstring>
+#include <filesystem>
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+//the client side of the compile server,nothing here depends on llvm so helang-client starts fast
+
+//a request is the count of strings followed by the strings,cwd first and then argv,every string
+//is its length followed by its bytes
+//the reply is the output of the child followed by the exit code in its last 4 bytes
+
+string DefaultSocketPath() {
+	if (const char* path = getenv("HELANG_SOCKET"); path != nullptr && *path != '\0') {
+		return path;
+	}
+#ifdef _WIN32
+	return (fs::temp_directory_path() / "helang.sock").string();
+#else
+	//a directory of this user,other users can't take the name of the socket before the server
+	if (const char* dir = getenv("XDG_RUNTIME_DIR"); dir != nullptr && *dir != '\0') {
+		return (fs::path(dir) / "helang.sock").string();
+	}
+	return (fs::temp_directory_path() / ("helang-" + to_string(getuid())) / "helang.sock").string();
+#endif
+}
+
+#ifdef _WIN32
+
+optional<int> RunClient(const string& socket_path, const vector<string>& args) {
+	return {};
+}
+
+#else
+
+bool WriteAll(int fd, const void* data, usize size) {
+	const char* p = (const char*)data;
+	while (size > 0) {
+		ssize_t n = write(fd, p, size);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+bool ReadAll(int fd, void* data, usize size) {
+	char* p = (char*)data;
+	while (size > 0) {
+		ssize_t n = read(fd, p, size);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return false;
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+optional<sockaddr_un> SocketAddress(const string& path) {
+	sockaddr_un addr{};
+	if (path.size() >= sizeof(addr.sun_path)) {
+		return {};
+	}
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+	return addr;
+}
+
+int ConnectSocket(const string& path) {
+	auto addr = SocketAddress(path);
+	if (!addr.has_value()) {
+		return -1;
+	}
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	if (connect(fd, (sockaddr*)&addr.value(), sizeof(sockaddr_un)) != 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+bool PeerIsUser(int fd) {
+#ifdef SO_PEERCRED
+	ucred cred;
+	socklen_t size = sizeof(cred);
+	return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0 && cred.uid == getuid();
+#else
+	uid_t uid;
+	gid_t gid;
+	return getpeereid(fd, &uid, &gid) == 0 && uid == getuid();
+#endif
+}
+
+bool PrepareSocketDirectory(const string& socket_path, string& error) {
+	string dir = fs::path(socket_path).parent_path().string();
+	if (dir.empty()) {
+		dir = ".";
+	}
+	struct stat st;
+	if ((mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) || lstat(dir.c_str(), &st) != 0) {
+		error = "fail to create the directory " + dir + " : " + strerror(errno);
+		return false;
+	}
+	//nobody else may remove or replace the socket,nor list or reach it
+	if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 07777) != 0700) {
+		error = dir + " isn't a directory of this user with mode 0700";
+		return false;
+	}
+	return true;
+}
+
+optional<int> RunClient(const string& socket_path, const vector<string>& args) {
+	int fd = ConnectSocket(socket_path);
+	if (fd < 0) {
+		return {};
+	}
+	//the cwd and arguments only go to a server of this user
+	if (!PeerIsUser(fd)) {
+		close(fd);
+		printf("helang: %s is served by another user,it is ignored\n", socket_path.c_str());
+		return {};
+	}
+	vector<string> request = { fs::current_path().string() };
+	request.insert(request.end(), args.begin(), args.end());
+	string data;
+	auto append = [&](u32 v) { data.append((const char*)&v, sizeof(v)); };
+	append(request.size());
+	for (auto& s : request) {
+		append(s.size());
+		data += s;
+	}
+	if (!WriteAll(fd, data.data(), data.size())) {
+		close(fd);
+		return {};
+	}
+	shutdown(fd, SHUT_WR);
+
+	//the output is streamed as it comes,the last 4 bytes are held back since they may be the exit code
+	char buffer[4096 + 4];
+	usize held = 0;
+	while (true) {
+		ssize_t n = read(fd, buffer + held, sizeof(buffer) - held);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) break;
+		held += n;
+		if (held > 4) {
+			fwrite(buffer, 1, held - 4, stdout);
+			memmove(buffer, buffer + held - 4, 4);
+			held = 4;
+		}
+	}
+	close(fd);
+	fflush(stdout);
+	if (held != 4) {
+		printf("helang: the server closed the connection\n");
+		return -1;
+	}
+	i32 rtv;
+	memcpy(&rtv, buffer, 4);
+	return rtv;
+}
+
+#endif
@@ -1,6 +1,7 @@
 #include "cmdline.h"
 #include <filesystem>
 #include <sstream>
+#include <fstream>
 
 void ParamParser::InternalSet(const string& key, const string& value) {
 	table[key] = value;
@@ -39,6 +40,18 @@ ParamParser::ParamParser(int argc, const char** argvs, u32 tableCount, Parameter
 	}
 	for (u32 i = 0; i < argc;) {
 		string argv = argvs[i];
+		//--option=value form
+		if (auto eq = argv.find('='); eq != string::npos && !parameterTable.count(argv)) {
+			if (auto res = parameterTable.find(argv.substr(0, eq));res != parameterTable.end() && res->second->contains_value) {
+				ParameterTable* t = res->second;
+				this->table[t->key] = argv.substr(eq + 1);
+				i++;
+				if (t->callback != nullptr) {
+					t->callback(this, table, tableCount);
+				}
+				continue;
+			}
+		}
 		if (auto res = parameterTable.find(argv);res != parameterTable.end()) {
 			ParameterTable* t = res->second;
 			if (i + 1 < argc && t->contains_value) {
@@ -67,6 +80,27 @@ ParamParser::ParamParser(int argc, const char** argvs, u32 tableCount, Parameter
 	}
 }
 
+bool ExpandResponseFiles(vector<string>& args, string& error) {
+	vector<string> res;
+	for (auto& arg : args) {
+		if (arg.size() < 2 || arg[0] != '@') {
+			res.push_back(arg);
+			continue;
+		}
+		ifstream in(arg.substr(1));
+		if (!in) {
+			error = "can't read response file " + arg.substr(1);
+			return false;
+		}
+		for (string line; getline(in, line);) {
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			if (!line.empty()) res.push_back(line);
+		}
+	}
+	args = std::move(res);
+	return true;
+}
+
 string ZipString(const vector<string>& strs) {
 	string res;
 	for (u32 i = 0; i < strs.size();i++) {
@@ -76,7 +110,7 @@ string ZipString(const vector<string>& strs) {
 	return res;
 }
 
-vector<string> UnzipString(string& s) {
+vector<string> UnzipString(const string& s) {
 	vector<string> res;
 	for (u32 i = 0; i < s.size();) {
 		i32 j = s.find_first_of(';',i);
@@ -97,5 +97,10 @@ private:
 };
 
 
+//arguments of the form @file are replaced by the lines of file,one argument per line so paths
+//may contain spaces,the lines are not expanded again
+//returns false with error set if a file can't be read
+bool ExpandResponseFiles(vector<string>& args, string& error);
+
 string ZipString(const vector<string>& strs);
-vector<string> UnzipString(string& s);
\ No newline at end of file
+vector<string> UnzipString(const string& s);
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "ast.h"
 #include "codegen.h"
+#include "llvm/Transforms/Utils/Local.h"
 #include <sstream>
 
 using namespace llvm;
@@ -7,9 +8,16 @@ using namespace llvm;
 LLVMCodeGenContext::LLVMCodeGenContext(Config& config)
 {
 	dump = config.dump;
-
-	llvm_context = ptr<llvm::LLVMContext>(new llvm::LLVMContext());
-	llvm_module = ptr<llvm::Module>(new llvm::Module("helang", *llvm_context));
+	specialize_limit = config.specialize_limit;
+	specialize_report = config.specialize_report;
+	warn_tail = config.warn_tail;
+	multiversion = config.multiversion;
+	multiversion_levels = config.multiversion_levels;
+	profile_generate = config.profile_generate;
+	profile = config.profile;
+
+	llvm_context = make_unique<llvm::LLVMContext>();
+	llvm_module = make_unique<llvm::Module>("helang", *llvm_context);
 	ir_builder = ptr<llvm::IRBuilder<>>(new llvm::IRBuilder<>(*llvm_context));
 
 	//global context
@@ -132,27 +140,38 @@ optional<llvm::Value*> LLVMCodeGenContext::CreateLLVMTypeDefaultValue(string typ
 	}
 }
 
-static LLVMCodeGenContext* g_context;
+//every compile thread generates its own module
+static thread_local LLVMCodeGenContext* g_context;
 constexpr const char* entry_prefix = "__he_entry_";
 constexpr const char* entry = "main";
 
 bool LLVMCodeGenContext::GenerateCode(AST* ast) {
+	//the context of the caller is restored,e.g. a session compiling on a thread that is
+	//generating code itself
+	LLVMCodeGenContext* outer = g_context;
 	g_context = this;
-	if (auto v = ast->GenerateIRCode();v.has_value()) {
+	optional<string> v = ast->GenerateIRCode();
+	g_context = outer;
+	if (v.has_value()) {
 		if (dump) 
-			printf("generated code %s",v.value().c_str());
+			log += "generated code " + v.value();
 	}
 	else {
 		error = ast->ErrorMsg();
 		return false;
 	}
+	return true;
 }
 
 
 string Expr::ErrorPrefix() 
 {
-	return "fail to generate IR code at function " + g_context->context.back().func_name
-		+ "(" + to_string(line) + ":" + to_string(start) + "-" + to_string(end) + ")";
+	return "fail to generate IR code at function " + g_context->context.back().func_name + Location();
+}
+
+string Expr::Location()
+{
+	return "(" + to_string(line) + ":" + to_string(start) + "-" + to_string(end) + ")";
 }
 
 optional<llvm::Value*> NumberExpr::CodeGenerate(string& error) 
@@ -274,7 +293,42 @@ optional<llvm::Value*> CallExpr::CodeGenerate(string& error)
 		argvs.push_back(argv);
 	}
 
-	return g_context->ir_builder->CreateCall(func, argvs);
+	if (!tail)
+	{
+		return g_context->ir_builder->CreateCall(func, argvs);
+	}
+
+	auto& context = g_context->context.back();
+	Function* caller = g_context->GetContextFunction();
+	if (func == caller && context.tail_header != nullptr)
+	{
+		BasicBlock* from = g_context->ir_builder->GetInsertBlock();
+		for (u32 i = 0; i < argvs.size(); i++)
+		{
+			context.tail_phis[i]->addIncoming(argvs[i], from);
+		}
+		g_context->ir_builder->CreateBr(context.tail_header);
+	}
+	else if (func->getFunctionType() == caller->getFunctionType() && func->getCallingConv() == caller->getCallingConv())
+	{
+		CallInst* call = g_context->ir_builder->CreateCall(func, argvs);
+		call->setTailCallKind(CallInst::TCK_MustTail);
+		g_context->ir_builder->CreateRet(call);
+	}
+	else
+	{
+		if (g_context->warn_tail)
+		{
+			g_context->log += "helang: warning: call to " + this->func + " at function " + context.func_name + Location() +
+				" is in tail position but can't be a guaranteed tail call, its signature differs from the caller's\n";
+		}
+		return g_context->ir_builder->CreateCall(func, argvs);
+	}
+
+	//the code following a tail call is never executed,generate it into a block no one branches to
+	//and let removeUnreachableBlocks drop it once the function is verified
+	g_context->ir_builder->SetInsertPoint(BasicBlock::Create(*g_context->llvm_context, "tail_dead", caller));
+	return UndefValue::get(func->getReturnType());
 }
 
 //this function should not be called,we should call function generate instead
@@ -287,10 +341,7 @@ optional<llvm::Value*> FuncExpr::CodeGenerate(string& error)
 
 
 optional<llvm::Function*> SignatureExpr::FunctionSignatureGenerate(string& error) {
-	if (name == entry)
-	{
-		name = entry_prefix + name;
-	}
+	name = LinkName();
 	vector<Type*> argts; Type* rt_type = Type::getVoidTy(*g_context->llvm_context);
 	for (auto arg_decl : args)
 	{
@@ -329,6 +380,18 @@ optional<llvm::Function*> SignatureExpr::FunctionSignatureGenerate(string& error
 	return func;
 }
 
+string SignatureExpr::LinkName() {
+	return name == entry ? entry_prefix + name : name;
+}
+
+string SignatureExpr::TypeKey() {
+	string key = "(";
+	for (auto& arg : args) {
+		key += arg.type + ",";
+	}
+	return key + ")->" + return_type;
+}
+
 optional<llvm::Value*> SignatureExpr::CodeGenerate(string& error) {
 	he_assert(false);
 	return {};
@@ -336,10 +399,16 @@ optional<llvm::Value*> SignatureExpr::CodeGenerate(string& error) {
 
 optional<llvm::Function*> FuncExpr::FunctionSignatureGenerate(string& error) 
 {
-	return signature->FunctionSignatureGenerate(error);
+	auto v = signature->FunctionSignatureGenerate(error);
+	//specialized clones are only reachable from redirected calls in this module
+	if (v.has_value() && IsSpecialization())
+	{
+		v.value()->setLinkage(Function::InternalLinkage);
+	}
+	return v;
 }
 
-bool BodyExpr::GenerateBodyCode(string& error,bool generate_return) {
+bool BodyExpr::GenerateBodyCode(string& error,bool generate_return,llvm::Value** rt_value) {
 	Function* func = g_context->GetContextFunction();
 	he_assert(func != nullptr);
 
@@ -357,6 +426,8 @@ bool BodyExpr::GenerateBodyCode(string& error,bool generate_return) {
 		{
 			if(generate_return) 
 				g_context->ir_builder->CreateRet(v.value());
+			if (rt_value != nullptr)
+				*rt_value = v.value();
 		}
 		else
 		{
@@ -383,23 +454,74 @@ bool FuncExpr::FunctionBodyGenerate(string& error)
 	BasicBlock* BB = BasicBlock::Create(*g_context->llvm_context, "body", func);
 	g_context->ir_builder->SetInsertPoint(BB);
 
+	vector<CallExpr*> tail_calls;
+	CollectTailCalls(tail_calls);
+	bool self_tail = false;
+	for (CallExpr* call : tail_calls)
+	{
+		call->MarkTail();
+		self_tail |= call->GetFunc() == signature->GetName();
+	}
+
+	//self tail calls loop back to a header after the entry block,which keeps the allocas
+	auto& context = g_context->context.back();
+	if (self_tail)
+	{
+		context.tail_header = BasicBlock::Create(*g_context->llvm_context, "tailrecurse", func);
+		g_context->ir_builder->CreateBr(context.tail_header);
+		g_context->ir_builder->SetInsertPoint(context.tail_header);
+	}
+
 	for (auto& arg : func->args())
 	{
-		if (!g_context->InsertSSA(string(arg.getName()), &arg))
+		Value* value = &arg;
+		if (self_tail)
+		{
+			PHINode* phi = g_context->ir_builder->CreatePHI(arg.getType(), 2, arg.getName());
+			phi->addIncoming(&arg, BB);
+			context.tail_phis.push_back(phi);
+			value = phi;
+		}
+		if (!g_context->InsertSSA(string(arg.getName()), value))
 		{
 			error = ErrorPrefix() + " repeated function argument " + string(arg.getName());
 			return false;
 		}
 	}
+	for (auto& [name, num] : constant_args)
+	{
+		Value* value = ConstantInt::get(*g_context->llvm_context, APInt(32, stoi(num)));
+		if (!g_context->InsertSSA(name, value))
+		{
+			error = ErrorPrefix() + " repeated function argument " + name;
+			return false;
+		}
+	}
 
 
-	bool v = body->GenerateBodyCode(error,true);
+	Value* rt_value = nullptr;
+	bool v = body->GenerateBodyCode(error,!echo,&rt_value);
 
 	if (!v) {
 		func->eraseFromParent();
 		return false;
 	}
-	if (!body->HasReturnValue()) 
+	if (echo)
+	{
+		Type* t64 = Type::getInt64Ty(*g_context->llvm_context);
+		if (rt_value == nullptr || rt_value->getType()->isVoidTy())
+		{
+			g_context->echo_type = "void";
+			g_context->ir_builder->CreateRet(ConstantInt::get(t64, 0));
+		}
+		else
+		{
+			u32 bits = rt_value->getType()->getIntegerBitWidth();
+			g_context->echo_type = bits == 64 ? "u8" : "i" + to_string(bits);
+			g_context->ir_builder->CreateRet(g_context->ir_builder->CreateZExtOrBitCast(rt_value, t64));
+		}
+	}
+	else if (!body->HasReturnValue()) 
 	{
 		if (auto v = g_context->CreateLLVMTypeDefaultValue(signature->GetReturnType());!v.has_value()) 
 		{
@@ -427,6 +549,8 @@ bool FuncExpr::FunctionBodyGenerate(string& error)
 		error = ErrorPrefix() + error;
 		return false;
 	}
+	//drop the branches IfExpr cut off on constant conditions
+	removeUnreachableBlocks(*func);
 	g_context->PopContext();
 	
 	return true;
@@ -440,6 +564,9 @@ optional<llvm::Value*> TopLevelExpr::CodeGenerate(string& error)
 }
 
 optional<string> TopLevelExpr::IRGenerate(string& error) {
+	if (g_context->specialize_limit > 0) {
+		Specialize(g_context->specialize_limit, g_context->specialize_report ? &g_context->log : nullptr);
+	}
 	vector<Function*> gen_funcs;
 	for (auto f : funcs) {
 		if (auto v = f->FunctionSignatureGenerate(error);!v.has_value()) {
@@ -460,11 +587,61 @@ optional<string> TopLevelExpr::IRGenerate(string& error) {
 		if (!funcs[i]->FunctionBodyGenerate(error)) {
 			return {};
 		}
-		gen_funcs[i]->print(ss);
+		if ((funcs[i]->IsMultiversion() || g_context->multiversion) && !funcs[i]->IsSpecialization()) {
+			if (!g_context->GenerateMultiversion(gen_funcs[i], error)) {
+				error = funcs[i]->ErrorPrefix() + error;
+				return {};
+			}
+		}
+		//printing a function walks the whole module,only pay for it when the ir is dumped
+		if (g_context->dump) {
+			gen_funcs[i]->print(ss);
+		}
+	}
+	if (g_context->profile_generate) {
+		g_context->GenerateProfileCounters();
 	}
+	if (g_context->profile != nullptr) {
+		g_context->ApplyProfile();
+	}
+	g_context->GenerateDispatchResolver();
 	return { output };
 }
 
+void TopLevelExpr::Import(const vector<ptr<SignatureExpr>>& sigs) {
+	unordered_set<string> names;
+	for (auto& f : funcs) {
+		names.insert(f->GetSignature()->LinkName());
+	}
+	for (auto& f : extern_funcs) {
+		names.insert(f->LinkName());
+	}
+	for (auto& f : sigs) {
+		if (!names.count(f->LinkName())) {
+			extern_funcs.push_back(f);
+		}
+	}
+}
+
+void TopLevelExpr::Retain(const unordered_set<string>& names) {
+	vector<ptr<FuncExpr>> kept;
+	for (auto& f : funcs) {
+		if (names.count(f->GetSignature()->LinkName())) {
+			kept.push_back(f);
+		}
+	}
+	funcs = kept;
+}
+
+void TopLevelExpr::Signatures(vector<ptr<SignatureExpr>>& defined, vector<ptr<SignatureExpr>>& declared) {
+	for (auto& f : funcs) {
+		if (!f->IsSpecialization() && !f->IsEcho()) {
+			defined.push_back(f->GetSignature());
+		}
+	}
+	declared.insert(declared.end(), extern_funcs.begin(), extern_funcs.end());
+}
+
 optional<string> AST::GenerateIRCode() {
 	if (exprs == nullptr) {
 		error = "empty ast";
@@ -487,7 +664,7 @@ optional<llvm::Value*> AssignExpr::CodeGenerate(string& error)
 
 
 	AllocaInst* var;
-	if (auto v = g_context->FindVariable(name);v.value()) 
+	if (auto v = g_context->FindVariable(name);v.has_value()) 
 	{
 		var = v.value();
 	}
@@ -586,7 +763,14 @@ optional<llvm::Value*> IfExpr::CodeGenerate(string& error)
 		else {
 			return {};
 		}
-		g_context->ir_builder->CreateCondBr(vcond, then_blocks[i], then_end_blocks[i]);
+		//a condition folded to a constant branches unconditionally,the dead side is removed
+		//after the function is verified
+		if (ConstantInt* c = dyn_cast<ConstantInt>(vcond); c != nullptr && c->getType()->isIntegerTy(1)) {
+			g_context->ir_builder->CreateBr(c->isZero() ? then_end_blocks[i] : then_blocks[i]);
+		}
+		else {
+			g_context->ir_builder->CreateCondBr(vcond, then_blocks[i], then_end_blocks[i]);
+		}
 		g_context->ir_builder->SetInsertPoint(then_blocks[i]);
 		if (!then_block_body[i]->GenerateBodyCode(error,false)) {
 			return {};
@@ -13,20 +13,53 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
 
+//execution counts written by a program compiled with --profile-generate
+struct Profile
+{
+	//function key -> entry count followed by (executed,taken) of every conditional branch
+	unordered_map<string, vector<u64>> counters;
+
+	static optional<Profile> Load(const string& path, string& error);
+};
+
 struct LLVMCodeGenContext
 {
 	ptr<llvm::IRBuilder<>> ir_builder;
-	ptr<llvm::LLVMContext> llvm_context;
-	ptr<llvm::Module>      llvm_module;
+	//owned uniquely so the module can be handed over to the jit
+	unique_ptr<llvm::LLVMContext> llvm_context;
+	unique_ptr<llvm::Module>      llvm_module;
 
 	struct Context {
 		unordered_map<string, llvm::Value*> ssa;
 		unordered_map<string, llvm::AllocaInst*> variable;
 		string func_name;
+		//loop header self tail calls branch back to,its phis replace the arguments
+		llvm::BasicBlock* tail_header = nullptr;
+		vector<llvm::PHINode*> tail_phis;
 	};
 	vector<Context> context;
 	string error;
+	//diagnostics and dumps of this compilation,printed by the caller in input order
+	string log;
 	bool   dump;
+	u32    specialize_limit;
+	bool   specialize_report;
+	bool   warn_tail;
+	bool   multiversion;
+	vector<string> multiversion_levels;
+	bool   profile_generate;
+	ptr<Profile> profile;
+
+	//a multiversioned function's slot and the clones a module constructor picks from
+	struct Dispatch {
+		llvm::GlobalVariable* slot;
+		llvm::Function* fallback;
+		//(level,clone) in ascending level order
+		vector<pair<u32, llvm::Function*>> clones;
+	};
+	vector<Dispatch> dispatch_table;
+	//type of the value returned by the echo function of a repl entry,void if there is none
+	string echo_type;
 
 	LLVMCodeGenContext(Config& config);
 
@@ -50,7 +83,21 @@ struct LLVMCodeGenContext
 
 	bool GenerateCode(AST* ast);
 
+	//clone func for every micro-architecture level and turn func into a dispatcher
+	bool GenerateMultiversion(llvm::Function* func, string& error);
+	//module constructor filling the dispatch slots according to the running cpu
+	void GenerateDispatchResolver();
+
+	//count function entries and conditional branches,a module constructor registers the
+	//counters with the runtime which writes them out at exit
+	void GenerateProfileCounters();
+	//attach entry counts and branch weights read from the profile
+	void ApplyProfile();
+
 	string ErrorMsg() { return error; }
 
 	llvm::Function* GetContextFunction();
-};
\ No newline at end of file
+};
+
+//whether name is a micro-architecture level multiversioned functions can be compiled for
+bool IsMicroArchLevel(const string& name);
\ No newline at end of file
@@ -11,9 +11,15 @@ using i8  = int8_t;
 using u32 = uint32_t;
 using u16 = uint16_t;
 using u8  = uint8_t;
+using u64 = uint64_t;
 using usize = size_t;
 
-#define he_assert(expr) if(!(expr)) {printf("assertion fail at file:%s,line:%d",__FILE__,__LINE__);__debugbreak();}
+#ifdef _MSC_VER
+#define he_debugbreak() __debugbreak()
+#else
+#define he_debugbreak() __builtin_trap()
+#endif
+#define he_assert(expr) if(!(expr)) {printf("assertion fail at file:%s,line:%d",__FILE__,__LINE__);he_debugbreak();}
 #define he_countof(arr) sizeof(arr) / sizeof(arr[0])
 
 template<typename T>
@@ -0,0 +1,172 @@
+#include "compiler.h"
+#include "runtime.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Analysis/ModuleSummaryAnalysis.h"
+#include "llvm/Analysis/ProfileSummaryInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/CodeGen/ParallelCG.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+#include <atomic>
+
+//resolve -mcpu=native to the host cpu,host features come before the ones given by -mattr
+//so the latter can override them
+void ResolveTargetCPU(Config& config) {
+	if (config.cpu != "native") {
+		return;
+	}
+	config.cpu = llvm::sys::getHostCPUName().str();
+
+	llvm::StringMap<bool> host_features;
+	string features;
+	if (llvm::sys::getHostCPUFeatures(host_features)) {
+		for (auto& f : host_features) {
+			if (!features.empty()) features += ',';
+			features += (f.getValue() ? "+" : "-") + f.getKey().str();
+		}
+	}
+	if (!config.features.empty()) {
+		if (!features.empty()) features += ',';
+		features += config.features;
+	}
+	config.features = features;
+}
+
+void RecordTarget(llvm::Module& module, Config& config) {
+	for (auto& f : module) {
+		//multiversioned clones keep their own micro-architecture level
+		if (f.isDeclaration() || f.hasFnAttribute("target-cpu")) continue;
+		f.addFnAttr("target-cpu", config.cpu);
+		if (!config.features.empty()) {
+			f.addFnAttr("target-features", config.features);
+		}
+	}
+
+	string record = "cpu=" + config.cpu + ";features=" + config.features;
+	llvm::Constant* str = llvm::ConstantDataArray::getString(module.getContext(), record);
+	llvm::GlobalVariable* target = new llvm::GlobalVariable(module, str->getType(), true,
+		llvm::GlobalValue::PrivateLinkage, str, "__he_target");
+	target->setSection(".helang.target");
+	llvm::appendToUsed(module, { target });
+}
+
+unique_ptr<llvm::TargetMachine> CreateTargetMachine(Config& config, string& error) {
+	string target_triple = llvm::sys::getDefaultTargetTriple();
+	const llvm::Target* target = llvm::TargetRegistry::lookupTarget(target_triple, error);
+	if (target == nullptr) {
+		return nullptr;
+	}
+	return unique_ptr<llvm::TargetMachine>(
+		target->createTargetMachine(target_triple, config.cpu, config.features, llvm::TargetOptions{}, {}));
+}
+
+ptr<LLVMCodeGenContext> GenerateParsedModule(const string& name, AST& ast, Config& config,
+	llvm::TargetMachine* target_machine, string& log) {
+	ptr<LLVMCodeGenContext> context(new LLVMCodeGenContext(config));
+
+	string target_triple = target_machine->getTargetTriple().str();
+	context->llvm_module->setTargetTriple(target_triple);
+	//internal functions are told apart by their file in the profile
+	context->llvm_module->setSourceFileName(name);
+	//the jit names the initializers of a module after its identifier
+	context->llvm_module->setModuleIdentifier(name);
+
+	bool generated = context->GenerateCode(&ast);
+	log += context->log;
+	if (!generated) {
+		log += "helang: " + ast.ErrorMsg() + "\n";
+		return nullptr;
+	}
+
+	context->llvm_module->setDataLayout(target_machine->createDataLayout());
+	if (config.runtime != nullptr && !LinkRuntime(*context->llvm_module, *config.runtime, log)) {
+		return nullptr;
+	}
+	RecordTarget(*context->llvm_module, config);
+	return context;
+}
+
+ptr<AST> ParseModule(const string& code, string& log) {
+	//the lexer keeps the last error,so every compilation uses its own
+	Lexer lexer;
+	optional<vector<Token>> tokens = lexer.Parse(code);
+	if (!tokens.has_value()) {
+		log += "helang: " + lexer.ErrorMsg() + "\n";
+		return nullptr;
+	}
+
+	ptr<AST> ast(new AST);
+	bool parsed = ast->Parse(tokens.value());
+	//the ast keeps what it needs of the tokens,they aren't held during code generation
+	tokens.reset();
+	if (!parsed) {
+		log += "helang: " + ast->ErrorMsg() + "\n";
+		return nullptr;
+	}
+	return ast;
+}
+
+ptr<LLVMCodeGenContext> GenerateModule(const string& name, const string& code, Config& config,
+	llvm::TargetMachine* target_machine, string& log, ptr<AST>* ast_out) {
+	ptr<AST> ast = ParseModule(code, log);
+	if (ast == nullptr) {
+		return nullptr;
+	}
+	//a module is looked up next to its importer on disk
+	if (!ast->Imports().empty()) {
+		const Token& t = ast->Imports().front();
+		log += "helang: import " + t.token + " at (" + to_string(t.line) + ":" + to_string(t.start) + "-" +
+			to_string(t.end) + ") : a source compiled in memory can't import\n";
+		return nullptr;
+	}
+
+	ptr<LLVMCodeGenContext> context = GenerateParsedModule(name, *ast, config, target_machine, log);
+	if (context == nullptr) {
+		return nullptr;
+	}
+	if (ast_out != nullptr) {
+		*ast_out = ast;
+	}
+	return context;
+}
+
+bool EmitObject(llvm::Module& module, llvm::TargetMachine* target_machine, llvm::raw_pwrite_stream& dest, string& log) {
+	llvm::legacy::PassManager pass_manager;
+	if (target_machine->addPassesToEmitFile(pass_manager,dest,nullptr,llvm::CGFT_ObjectFile)) {
+		log += "llvm can't emit object file\n";
+		return false;
+	}
+	pass_manager.run(module);
+	return true;
+}
+
+bool EmitSplitObjects(llvm::Module& module, const vector<llvm::raw_pwrite_stream*>& streams, Config& config, string& log) {
+	//the target machines are made up front so a failure is reported before any partition is
+	//generated,the threads of splitCodeGen take one each
+	vector<unique_ptr<llvm::TargetMachine>> machines;
+	for (usize k = 0; k < streams.size(); k++) {
+		string error;
+		machines.push_back(CreateTargetMachine(config, error));
+		if (machines.back() == nullptr) {
+			log += "helang: " + error + "\n";
+			return false;
+		}
+	}
+	atomic<usize> next{ 0 };
+	auto factory = [&]() {
+		return std::move(machines[next++]);
+	};
+	//internal functions such as specialized clones stay internal and are kept in the partition
+	//of their callers,so objects of different files can't clash on promoted names
+	llvm::splitCodeGen(module, streams, {}, factory, llvm::CGFT_ObjectFile, true);
+	return true;
+}
+
+void EmitSummaryBitcode(llvm::Module& module, llvm::raw_ostream& dest) {
+	llvm::ProfileSummaryInfo psi(module);
+	llvm::ModuleSummaryIndex index = llvm::buildModuleSummaryIndex(module, nullptr, &psi);
+	//the module hash keys the thinlto cache
+	llvm::WriteBitcodeToFile(module, dest, false, &index, true);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "codegen.h"
+#include "llvm/Target/TargetMachine.h"
+
+//the compile pipeline shared by helang-c and helang::Session
+
+//resolve -mcpu=native to the host cpu and its features
+void ResolveTargetCPU(Config& config);
+//tag every defined function with the target it is compiled for and keep the choice in
+//the .helang.target section of the object
+void RecordTarget(llvm::Module& module, Config& config);
+//target machine of config for the host triple,nullptr if the target isn't registered
+unique_ptr<llvm::TargetMachine> CreateTargetMachine(Config& config, string& error);
+
+//lex and parse a source,returns nullptr with log set if it fails
+ptr<AST> ParseModule(const string& code, string& log);
+//lex,parse and generate the module of one source,name identifies it in diagnostics,the profile
+//and the jit,diagnostics are appended to log
+//nothing is read from or written to disk,a source with imports is an error,the file drivers
+//declare the imports themselves before GenerateParsedModule
+//returns nullptr if the source fails to compile,the ast is kept in ast_out if given
+ptr<LLVMCodeGenContext> GenerateModule(const string& name, const string& code, Config& config,
+	llvm::TargetMachine* target_machine, string& log, ptr<AST>* ast_out = nullptr);
+//generate the module of a parsed ast whose imports are declared,the steps of GenerateModule
+//after parsing
+ptr<LLVMCodeGenContext> GenerateParsedModule(const string& name, AST& ast, Config& config,
+	llvm::TargetMachine* target_machine, string& log);
+//run instruction selection on the module and write the object file to dest
+bool EmitObject(llvm::Module& module, llvm::TargetMachine* target_machine, llvm::raw_pwrite_stream& dest, string& log);
+//split the module into one partition per stream and emit the objects of the partitions in parallel
+//returns false with log set if a target machine can't be created
+bool EmitSplitObjects(llvm::Module& module, const vector<llvm::raw_pwrite_stream*>& streams, Config& config, string& log);
+//write the module as bitcode with its summary,the thinlto link of the helang driver uses the
+//summaries to import functions across files before generating code for each module
+void EmitSummaryBitcode(llvm::Module& module, llvm::raw_ostream& dest);
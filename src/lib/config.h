@@ -1,8 +1,44 @@
 #pragma once
 #include "common.h"
 
+struct Profile;
+
 
 struct Config {
 	string search_path;
 	bool   dump;
+	//max call-site specializations per function,0 disables the pass
+	u32    specialize_limit;
+	bool   specialize_report;
+	//warn about calls in tail position which can't be guaranteed tail calls
+	bool   warn_tail;
+	//multiversion every function,not only the ones marked multiversion
+	bool   multiversion;
+	//micro-architecture levels multiversioned functions are cloned for (v2,v3,v4)
+	vector<string> multiversion_levels;
+	//target cpu and feature string passed to the target machine
+	string cpu;
+	string features;
+	//number of partitions a module is split into for parallel code generation
+	u32    split;
+	//tokens of top-level items helang-c --stream compiles at a time,0 compiles a file at once
+	u32    stream;
+	//obj for native objects,bc for bitcode with a thinlto summary linked by the helang driver
+	string emit;
+	//the files compiled to objects or bitcode get their interface written next to them and the
+	//stale interfaces of the modules they import are made again,off for in-memory compilations
+	bool   interfaces;
+	//insert edge counters written to a profile when the program exits
+	bool   profile_generate;
+	//profile read by --profile-use,nullptr if there is none
+	ptr<Profile> profile;
+	//bitcode of the runtime linked into every module,nullptr to leave the runtime to the linker
+	ptr<string> runtime;
+	//--run compiles functions on their first call and with jit_threads background threads
+	bool   jit_lazy;
+	u32    jit_threads;
+	//--run engine,jit,interp for the bytecode interpreter or tiered
+	string engine;
+	//entries and back edges after which tiered promotes a function to the jit
+	u32    tier_threshold;
 };
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+#include "common.h"
+#include <optional>
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+
+struct Config;
+namespace llvm {
+	class TargetMachine;
+	namespace orc {
+		class LLJIT;
+	}
+}
+
+//the compiler as a library,sources are passed as text so nothing is read from disk
+//a session is used by one thread at a time,every thread compiling in parallel creates its own
+//session,sessions share no state
+namespace helang {
+
+	struct Options
+	{
+		//target cpu and feature string,native for the host
+		string cpu = "generic";
+		string features;
+		//max call-site specializations per function,0 disables the pass
+		u32    specialize_limit = 4;
+		bool   warn_tail = false;
+		//multiversion every function for the levels
+		bool   multiversion = false;
+		vector<string> multiversion_levels = { "v2","v3","v4" };
+	};
+
+	class Session;
+
+	//modules compiled into a jit of their own
+	class Program
+	{
+	public:
+		~Program();
+		//address of a function of the program,the module constructors run on the first lookup
+		//returns nullptr if there is no such function
+		void* Lookup(const string& name);
+		//run main,the value of main is returned
+		optional<int> Run(string& error);
+
+	private:
+		friend class Session;
+		Program() = default;
+		bool Initialize(string& error);
+
+		unique_ptr<llvm::orc::LLJIT> jit;
+		bool initialized = false;
+	};
+
+	class Session
+	{
+	public:
+		Session(const Options& options = Options());
+		~Session();
+
+		//compile a source to a native object file for the target of the options
+		//name identifies the source in diagnostics,returns nothing if it fails to compile
+		optional<vector<char>> CompileObject(const string& name, const string& source);
+		//compile a source to an llvm module owned by the caller
+		optional<llvm::orc::ThreadSafeModule> CompileModule(const string& name, const string& source);
+		//compile and link the sources,given as name and text,into a program for this process
+		ptr<Program> CompileProgram(const vector<pair<string, string>>& sources);
+		//diagnostics of the last compilation
+		const string& Log() { return log; }
+
+	private:
+		llvm::TargetMachine* Target();
+
+		unique_ptr<Config> config;
+		unique_ptr<llvm::TargetMachine> target_machine;
+		string log;
+	};
+}
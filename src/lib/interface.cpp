@@ -0,0 +1,271 @@
+#include "interface.h"
+#include "ast.h"
+#include "builddb.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+static const char g_interface_magic[4] = { 'H', 'E', 'I', '1' };
+static const u8 g_interface_multiversion = 1;
+
+string ModuleSource(const string& importer, const string& name) {
+	return (fs::path(importer).parent_path() / (name + ".he")).string();
+}
+
+string InterfacePath(const string& source) {
+	return fs::path(source).replace_extension(".hei").string();
+}
+
+static optional<string> ReadFile(const string& path) {
+	ifstream in(path, ios::binary);
+	if (!in) {
+		return {};
+	}
+	return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+static void PutInt(string& out, u64 v, u32 bytes) {
+	for (u32 i = 0; i < bytes; i++) {
+		out += (char)((v >> (i * 8)) & 0xff);
+	}
+}
+
+static void PutString(string& out, const string& s) {
+	PutInt(out, s.size(), 4);
+	out += s;
+}
+
+//reads the interface front to back,any read past the end leaves ok false
+struct InterfaceReader {
+	const string& data;
+	usize p = 0;
+	bool ok = true;
+
+	u64 Int(u32 bytes) {
+		if (data.size() - p < bytes) {
+			ok = false;
+			return 0;
+		}
+		u64 v = 0;
+		for (u32 i = 0; i < bytes; i++) {
+			v |= (u64)(u8)data[p++] << (i * 8);
+		}
+		return v;
+	}
+	string String() {
+		u64 size = Int(4);
+		if (!ok || data.size() - p < size) {
+			ok = false;
+			return "";
+		}
+		p += size;
+		return data.substr(p - size, size);
+	}
+};
+
+//functions other modules can call,main is the entry of the program and specialized clones are
+//internal
+static vector<FuncExpr*> Exports(const vector<ptr<FuncExpr>>& funcs) {
+	vector<FuncExpr*> res;
+	for (auto& f : funcs) {
+		ptr<SignatureExpr> sig = f->GetSignature();
+		if (f->IsSpecialization() || f->IsEcho() || sig->LinkName() != sig->GetName()) continue;
+		res.push_back(f.get());
+	}
+	return res;
+}
+
+static bool InterfaceUpToDate(const string& path, u64 hash) {
+	char header[12];
+	ifstream in(path, ios::binary);
+	if (!in.read(header, sizeof(header)) || memcmp(header, g_interface_magic, 4) != 0) {
+		return false;
+	}
+	string stored(header + 4, 8);
+	InterfaceReader reader{ stored };
+	return reader.Int(8) == hash;
+}
+
+bool WriteInterface(const string& source, u64 hash, const vector<ptr<FuncExpr>>& funcs, string& error) {
+	string path = InterfacePath(source);
+	if (InterfaceUpToDate(path, hash)) {
+		return true;
+	}
+	string out(g_interface_magic, 4);
+	PutInt(out, hash, 8);
+	vector<FuncExpr*> exports = Exports(funcs);
+	PutInt(out, exports.size(), 4);
+	for (FuncExpr* f : exports) {
+		ptr<SignatureExpr> sig = f->GetSignature();
+		PutInt(out, f->IsMultiversion() ? g_interface_multiversion : 0, 1);
+		PutString(out, sig->GetName());
+		PutString(out, sig->GetReturnType());
+		PutInt(out, sig->GetArgs().size(), 4);
+		for (auto& arg : sig->GetArgs()) {
+			PutString(out, arg.type);
+			PutString(out, arg.name);
+		}
+	}
+
+	//parallel compilations may write the same interface,every one renames its own file over it
+	auto temp = llvm::sys::fs::TempFile::create(path + ".%%%%%%.tmp");
+	if (!temp) {
+		llvm::consumeError(temp.takeError());
+		error = "can't write the interface " + path;
+		return false;
+	}
+	{
+		llvm::raw_fd_ostream os(temp->FD, false);
+		os << out;
+	}
+	if (llvm::Error e = temp->keep(path)) {
+		llvm::consumeError(std::move(e));
+		error = "can't write the interface " + path;
+		return false;
+	}
+	return true;
+}
+
+static optional<vector<ptr<SignatureExpr>>> ReadInterface(const string& data, u64 hash) {
+	if (data.size() < 4 || memcmp(data.data(), g_interface_magic, 4) != 0) {
+		return {};
+	}
+	InterfaceReader reader{ data, 4 };
+	if (reader.Int(8) != hash) {
+		return {};
+	}
+	vector<ptr<SignatureExpr>> sigs;
+	u64 count = reader.Int(4);
+	for (u64 i = 0; i < count && reader.ok; i++) {
+		reader.Int(1);
+		string name = reader.String(), return_type = reader.String();
+		vector<Declearation> args(reader.ok ? reader.Int(4) : 0);
+		for (auto& arg : args) {
+			arg.type = reader.String();
+			arg.name = reader.String();
+			if (!reader.ok) break;
+		}
+		Token token{ HE_TOKEN_IDENTIFIER, name, 0, 0, 0 };
+		sigs.push_back(ptr<SignatureExpr>(new SignatureExpr(return_type, name, args, token)));
+	}
+	if (!reader.ok) {
+		return {};
+	}
+	return sigs;
+}
+
+optional<vector<ptr<SignatureExpr>>> LoadInterface(const string& source, bool refresh, string& error) {
+	auto code = ReadFile(source);
+	if (!code.has_value()) {
+		error = "can't read " + source;
+		return {};
+	}
+	u64 hash = HashContent(code.value());
+	if (auto data = ReadFile(InterfacePath(source)); data.has_value()) {
+		if (auto sigs = ReadInterface(data.value(), hash); sigs.has_value()) {
+			return sigs;
+		}
+	}
+
+	//the interface is missing or stale,the signatures are taken from the source
+	Lexer lexer;
+	auto tokens = lexer.Parse(code.value());
+	if (!tokens.has_value()) {
+		error = source + " : " + lexer.ErrorMsg();
+		return {};
+	}
+	AST ast;
+	if (!ast.Parse(tokens.value())) {
+		error = source + " : " + ast.ErrorMsg();
+		return {};
+	}
+	vector<ptr<SignatureExpr>> sigs;
+	for (FuncExpr* f : Exports(ast.Functions())) {
+		sigs.push_back(f->GetSignature());
+	}
+	//a source in a read-only directory can still be imported
+	if (refresh) {
+		string ignored;
+		WriteInterface(source, hash, ast.Functions(), ignored);
+	}
+	return sigs;
+}
+
+u64 InterfaceDigest(const vector<ptr<SignatureExpr>>& sigs) {
+	string keys;
+	for (auto& sig : sigs) {
+		keys += sig->GetName() + sig->TypeKey() + ";";
+	}
+	return HashContent(keys);
+}
+
+optional<vector<ptr<SignatureExpr>>> LoadImports(const vector<Token>& imports, const string& importer,
+	const vector<ptr<SignatureExpr>>& defined, const vector<ptr<SignatureExpr>>& declared, bool refresh, string& error) {
+	unordered_set<string> own;
+	unordered_map<string, string> own_declared;
+	for (auto& s : defined) {
+		own.insert(s->GetName());
+	}
+	for (auto& s : declared) {
+		own_declared[s->GetName()] = s->TypeKey();
+	}
+
+	vector<ptr<SignatureExpr>> imported;
+	unordered_map<string, string> module_of;
+	for (auto& t : imports) {
+		string prefix = "import " + t.token + " at (" + to_string(t.line) + ":" + to_string(t.start) + "-" +
+			to_string(t.end) + ") : ";
+		string source = ModuleSource(importer, t.token);
+		std::error_code EC;
+		if (fs::equivalent(source, importer, EC)) {
+			error = prefix + "a module can't import itself";
+			return {};
+		}
+		auto sigs = LoadInterface(source, refresh, error);
+		if (!sigs.has_value()) {
+			error = prefix + error;
+			return {};
+		}
+		for (auto& sig : sigs.value()) {
+			string name = sig->GetName();
+			if (auto m = module_of.find(name); m != module_of.end()) {
+				if (m->second == t.token) continue;
+				error = prefix + "function " + name + " is exported by both " + m->second + " and " + t.token;
+				return {};
+			}
+			module_of[name] = t.token;
+			if (own.count(name)) {
+				error = prefix + "function " + name + " is defined in this file and in " + t.token;
+				return {};
+			}
+			if (auto v = own_declared.find(name); v != own_declared.end() && v->second != sig->TypeKey()) {
+				error = prefix + "ccnd declares " + name + v->second + " but " + t.token + " defines " + name +
+					sig->TypeKey();
+				return {};
+			}
+			imported.push_back(sig);
+		}
+	}
+	return imported;
+}
+
+bool ImportModules(AST& ast, const string& importer, bool refresh, string& error) {
+	if (ast.Imports().empty()) {
+		return true;
+	}
+	vector<ptr<SignatureExpr>> defined, declared;
+	ast.Signatures(defined, declared);
+	auto imported = LoadImports(ast.Imports(), importer, defined, declared, refresh, error);
+	if (!imported.has_value()) {
+		return false;
+	}
+	ast.Import(imported.value());
+	return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "common.h"
+
+class AST;
+class FuncExpr;
+class SignatureExpr;
+struct Token;
+
+//module interfaces,compiling a.he writes a.hei next to it with the signatures of the functions
+//a.he defines,import a; in a file of the same directory declares them from the interface
+//without lexing or parsing a.he again
+//  HEI1,the content hash of a.he,the function count,then per function its flags,name,return
+//  type,argument count and the type and name of every argument
+//integers are little endian u32 except the u64 hash,strings are a u32 length and the bytes
+//an interface whose hash isn't the one of the source is stale and is made again from the source
+
+//path of the source of module name imported by the file importer
+string ModuleSource(const string& importer, const string& name);
+string InterfacePath(const string& source);
+
+//write the interface of the functions of a source with content hash,unless the file already has it
+bool WriteInterface(const string& source, u64 hash, const vector<ptr<FuncExpr>>& funcs, string& error);
+//signatures exported by the module at source,a missing or stale interface is made again from the
+//source and written if refresh,returns nothing with error set if the source can't be read or parsed
+optional<vector<ptr<SignatureExpr>>> LoadInterface(const string& source, bool refresh, string& error);
+//hash of the names and types of the signatures,a change in the source that keeps them keeps it
+u64 InterfaceDigest(const vector<ptr<SignatureExpr>>& sigs);
+
+//signatures of the modules imported by a file which defines and declares the given functions,
+//a ccnd declaration of an imported function must have its type
+optional<vector<ptr<SignatureExpr>>> LoadImports(const vector<Token>& imports, const string& importer,
+	const vector<ptr<SignatureExpr>>& defined, const vector<ptr<SignatureExpr>>& declared, bool refresh, string& error);
+//declare the functions of the modules ast imports
+bool ImportModules(AST& ast, const string& importer, bool refresh, string& error);
@@ -0,0 +1,369 @@
+#include "bytecode.h"
+#include "jit.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+using namespace llvm;
+
+//bytecode interpreter and tier-up
+//a function reaching the tier threshold is queued to a background thread,which creates a lazy jit
+//from the modules on its first request and looks the function up in it,calls made after the lookup
+//finishes go to the compiled code,the same goes for self tail calls of a running loop since all of
+//its state is in the arguments
+
+//ffi thunks,arguments are passed as 64 bit integers,callees taking i32 only read the low half
+using Thunk = u64(*)(void* addr, const u64* args);
+constexpr u32 max_thunk_args = 8;
+
+template<size_t... I>
+static u64 CallWithArgs(void* addr, const u64* args, index_sequence<I...>)
+{
+	using Func = u64(*)(decltype((void)I, u64())...);
+	return reinterpret_cast<Func>(addr)(args[I]...);
+}
+
+template<size_t N>
+static u64 CallThunk(void* addr, const u64* args)
+{
+	return CallWithArgs(addr, args, make_index_sequence<N>{});
+}
+
+static Thunk g_thunks[max_thunk_args + 1] = {
+	CallThunk<0>, CallThunk<1>, CallThunk<2>, CallThunk<3>, CallThunk<4>,
+	CallThunk<5>, CallThunk<6>, CallThunk<7>, CallThunk<8>,
+};
+
+//only the low 32 bits of an i32 returned in a 64 bit register are defined
+static inline u64 Normalize(u64 value, HE_VALUE_TYPE type)
+{
+	switch (type)
+	{
+	case HE_VALUE_I32: return (u32)value;
+	case HE_VALUE_I64: return value;
+	case HE_VALUE_I1:  return value & 1;
+	default:           return 0;
+	}
+}
+
+class TierUp
+{
+public:
+	TierUp(vector<ptr<LLVMCodeGenContext>>& contexts, Config& config) :config(config)
+	{
+		for (u32 k = 0; k < contexts.size(); k++)
+		{
+			unique_ptr<Module> module = std::move(contexts[k]->llvm_module);
+			//internal functions such as specialized clones can't be looked up,they are exported
+			//under a name unique to their file
+			for (auto& f : *module)
+			{
+				if (f.isDeclaration() || !f.hasLocalLinkage()) continue;
+				f.setName(f.getName() + ".m" + to_string(k));
+				f.setLinkage(GlobalValue::ExternalLinkage);
+			}
+			modules.emplace_back(std::move(module), std::move(contexts[k]->llvm_context));
+		}
+		worker = std::thread([this]() { Work(); });
+	}
+
+	~TierUp()
+	{
+		Finish();
+	}
+
+	//stop once the function being compiled is done,returns the warnings of the tier-up thread
+	string Finish()
+	{
+		if (worker.joinable())
+		{
+			{
+				lock_guard<mutex> lock(m);
+				stop = true;
+			}
+			cv.notify_all();
+			worker.join();
+		}
+		return log;
+	}
+
+	void Request(BytecodeFunction* func)
+	{
+		if (func->args > max_thunk_args)
+		{
+			return;
+		}
+		{
+			lock_guard<mutex> lock(m);
+			queue.push_back(func);
+		}
+		cv.notify_all();
+	}
+
+private:
+	void Work()
+	{
+		unique_lock<mutex> lock(m);
+		while (true)
+		{
+			cv.wait(lock, [&]() { return stop || !queue.empty(); });
+			if (stop)
+			{
+				break;
+			}
+			BytecodeFunction* func = queue.front();
+			queue.pop_front();
+			lock.unlock();
+			Compile(func);
+			lock.lock();
+		}
+	}
+
+	bool CreateJIT()
+	{
+		auto j = ::CreateJIT(config, true);
+		if (!j)
+		{
+			log += "helang: warning: tier-up is disabled,fail to create jit : " + toString(j.takeError()) + "\n";
+			return false;
+		}
+		for (auto& tsm : modules)
+		{
+			if (Error e = static_cast<orc::LLLazyJIT&>(**j).addLazyIRModule(std::move(tsm)))
+			{
+				log += "helang: warning: tier-up is disabled : " + toString(std::move(e)) + "\n";
+				return false;
+			}
+		}
+		//the multiversion resolvers fill their slots before any compiled code runs
+		if (Error e = (*j)->initialize((*j)->getMainJITDylib()))
+		{
+			log += "helang: warning: tier-up is disabled : " + toString(std::move(e)) + "\n";
+			return false;
+		}
+		jit = std::move(*j);
+		return true;
+	}
+
+	void Compile(BytecodeFunction* func)
+	{
+		if (failed || (jit == nullptr && !CreateJIT()))
+		{
+			failed = true;
+			return;
+		}
+		auto sym = jit->lookup(func->jit_name);
+		if (!sym)
+		{
+			log += "helang: warning: fail to compile " + func->name + " : " + toString(sym.takeError()) + "\n";
+			return;
+		}
+		func->native.store(jitTargetAddressToPointer<void*>(sym->getAddress()), memory_order_release);
+	}
+
+	Config& config;
+	string log;
+	vector<orc::ThreadSafeModule> modules;
+	unique_ptr<orc::LLJIT> jit;
+	bool failed = false;
+
+	std::thread worker;
+	mutex m;
+	condition_variable cv;
+	deque<BytecodeFunction*> queue;
+	bool stop = false;
+};
+
+struct Frame
+{
+	BytecodeFunction* func;
+	const Instr* pc;
+	u64* regs;
+	u16 dst;
+};
+
+//registers of every frame live in one stack,1 << 22 registers take 32mb
+constexpr usize register_stack_size = 1 << 22;
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HE_COMPUTED_GOTO
+#endif
+
+static optional<int> Interpret(BytecodeProgram& program, BytecodeFunction* entry, TierUp* tier, u32 threshold,
+	string& error)
+{
+	unique_ptr<u64[]> stack(new u64[register_stack_size]);
+	u64* stack_end = stack.get() + register_stack_size;
+	vector<Frame> frames;
+	frames.reserve(1024);
+
+	BytecodeFunction* func = entry;
+	const Instr* code = func->code.data();
+	const Instr* pc = code;
+	u64* regs = stack.get();
+	if (regs + func->regs > stack_end)
+	{
+		error = "stack overflow";
+		return {};
+	}
+
+	auto hot = [&](BytecodeFunction* f) {
+		if (tier != nullptr && ++f->hotness == threshold)
+		{
+			tier->Request(f);
+		}
+	};
+
+#ifdef HE_COMPUTED_GOTO
+#define HE_LABEL_ADDR(name) &&L_##name,
+	static const void* labels[HE_OP_COUNT] = { HE_BYTECODE_OPS(HE_LABEL_ADDR) };
+#undef HE_LABEL_ADDR
+#define DISPATCH() goto *labels[pc->op]
+#define CASE(name) L_##name:
+	DISPATCH();
+#else
+#define DISPATCH() continue
+#define CASE(name) case HE_OP_##name:
+	while (true) switch (pc->op) {
+#endif
+
+#define RETURN(value) { \
+		u64 rtv = (value); \
+		if (frames.empty()) return (int)(u32)rtv; \
+		Frame& f = frames.back(); \
+		f.regs[f.dst] = rtv; \
+		func = f.func; code = func->code.data(); pc = f.pc; regs = f.regs; \
+		frames.pop_back(); \
+		DISPATCH(); \
+	}
+
+	CASE(LOADK)   { regs[pc->a] = pc->Imm(); pc++; DISPATCH(); }
+	CASE(MOV)     { regs[pc->a] = regs[pc->b]; pc++; DISPATCH(); }
+	CASE(ADD32)   { regs[pc->a] = (u32)(regs[pc->b] + regs[pc->c]); pc++; DISPATCH(); }
+	CASE(SUB32)   { regs[pc->a] = (u32)(regs[pc->b] - regs[pc->c]); pc++; DISPATCH(); }
+	CASE(MUL32)   { regs[pc->a] = (u32)(regs[pc->b] * regs[pc->c]); pc++; DISPATCH(); }
+	CASE(DIV32)   { regs[pc->a] = (u32)regs[pc->b] / (u32)regs[pc->c]; pc++; DISPATCH(); }
+	CASE(ADD64)   { regs[pc->a] = regs[pc->b] + regs[pc->c]; pc++; DISPATCH(); }
+	CASE(SUB64)   { regs[pc->a] = regs[pc->b] - regs[pc->c]; pc++; DISPATCH(); }
+	CASE(MUL64)   { regs[pc->a] = regs[pc->b] * regs[pc->c]; pc++; DISPATCH(); }
+	CASE(DIV64)   { regs[pc->a] = regs[pc->b] / regs[pc->c]; pc++; DISPATCH(); }
+	CASE(EQ)      { regs[pc->a] = regs[pc->b] == regs[pc->c]; pc++; DISPATCH(); }
+	CASE(NE)      { regs[pc->a] = regs[pc->b] != regs[pc->c]; pc++; DISPATCH(); }
+	CASE(SHL8_32) { regs[pc->a] = (u32)(regs[pc->b] << 8); pc++; DISPATCH(); }
+	CASE(SHL8_64) { regs[pc->a] = regs[pc->b] << 8; pc++; DISPATCH(); }
+	CASE(OR)      { regs[pc->a] = regs[pc->b] | regs[pc->c]; pc++; DISPATCH(); }
+	CASE(JMP)     { pc = code + pc->Imm(); DISPATCH(); }
+	CASE(JZ)      { pc = regs[pc->a] == 0 ? code + pc->Imm() : pc + 1; DISPATCH(); }
+	CASE(CALL)
+	{
+		BytecodeFunction* callee = program.funcs[pc->b].get();
+		u64* args = regs + pc->c;
+		if (void* native = callee->native.load(memory_order_acquire))
+		{
+			regs[pc->a] = Normalize(g_thunks[callee->args](native, args), callee->ret_type);
+			pc++;
+			DISPATCH();
+		}
+		hot(callee);
+		if (args + callee->regs > stack_end)
+		{
+			error = "stack overflow";
+			return {};
+		}
+		frames.push_back(Frame{ func, pc + 1, regs, pc->a });
+		func = callee;
+		code = pc = func->code.data();
+		regs = args;
+		DISPATCH();
+	}
+	CASE(CALLX)
+	{
+		BytecodeExtern& ext = program.externs[pc->b];
+		regs[pc->a] = Normalize(g_thunks[ext.args](ext.addr, regs + pc->c), ext.ret_type);
+		pc++;
+		DISPATCH();
+	}
+	CASE(TAILSELF)
+	{
+		u64* args = regs + pc->b;
+		if (void* native = func->native.load(memory_order_acquire))
+		{
+			RETURN(Normalize(g_thunks[func->args](native, args), func->ret_type));
+		}
+		hot(func);
+		memcpy(regs, args, func->args * sizeof(u64));
+		pc = code;
+		DISPATCH();
+	}
+	CASE(TAILCALL)
+	{
+		BytecodeFunction* callee = program.funcs[pc->b].get();
+		u64* args = regs + pc->c;
+		if (void* native = callee->native.load(memory_order_acquire))
+		{
+			RETURN(Normalize(g_thunks[callee->args](native, args), callee->ret_type));
+		}
+		hot(callee);
+		if (regs + callee->regs > stack_end)
+		{
+			error = "stack overflow";
+			return {};
+		}
+		memcpy(regs, args, callee->args * sizeof(u64));
+		func = callee;
+		code = pc = func->code.data();
+		DISPATCH();
+	}
+	CASE(RET)  RETURN(regs[pc->a])
+	CASE(RETV) RETURN(0)
+
+#ifndef HE_COMPUTED_GOTO
+	default:
+		he_assert(false);
+		return {};
+	}
+#endif
+#undef RETURN
+#undef CASE
+#undef DISPATCH
+}
+
+optional<int> RunBytecode(BytecodeProgram& program, vector<ptr<LLVMCodeGenContext>>& modules,
+	Config& config, string& error)
+{
+	for (auto& ext : program.externs)
+	{
+		if (!ext.used) continue;
+		if (ext.args > max_thunk_args)
+		{
+			error = "extern function " + ext.name + " has more than " + to_string(max_thunk_args) + " arguments";
+			return {};
+		}
+		if (ext.addr = FindHostSymbol(ext.name); ext.addr == nullptr)
+		{
+			error = "undefined function " + ext.name;
+			return {};
+		}
+	}
+	auto entry = program.func_index.find("__he_entry_main");
+	if (entry == program.func_index.end())
+	{
+		error = "main function is not defined";
+		return {};
+	}
+
+	unique_ptr<TierUp> tier;
+	if (config.engine == "tiered")
+	{
+		tier = make_unique<TierUp>(modules, config);
+	}
+	optional<int> rtv = Interpret(program, program.funcs[entry->second].get(), tier.get(), config.tier_threshold, error);
+	flush();
+	if (tier != nullptr)
+	{
+		fputs(tier->Finish().c_str(), stdout);
+	}
+	return rtv;
+}
@@ -1,6 +1,12 @@
 #include "io.h"
 #include <filesystem>
 #include <fstream>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
 namespace fs = std::filesystem;
 
 unique_ptr<IO> IO::g_io;
@@ -45,4 +51,33 @@ optional<string> IO::LoadFile(const string& file) {
 		return { string(buffer.data()) };
 	}
 	return {};
-}
\ No newline at end of file
+}
+
+string PartitionObjectName(const string& output, u32 k) {
+	if (k == 0) {
+		return output;
+	}
+	fs::path path = output;
+	path.replace_extension("." + to_string(k) + path.extension().string());
+	return path.string();
+}
+u64 PeakResidentSize() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	//kilobytes on linux
+	return (u64)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
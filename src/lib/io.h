@@ -11,4 +11,9 @@ public:
 	static bool Initialize(Config& config);
 	static IO&  Get();
 	optional<string> LoadFile(const string& file);
-};
\ No newline at end of file
+};
+
+//object file of the k-th codegen partition of output,partition 0 is output itself
+string PartitionObjectName(const string& output, u32 k);
+//peak resident set size of the process in bytes,0 if it can't be read
+u64 PeakResidentSize();
@@ -0,0 +1,153 @@
+#include "jit.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/Support/DynamicLibrary.h"
+
+using namespace llvm;
+
+//runtime functions from template/io.c and template/cpu.c
+extern "C" {
+	void print_i32(int n);
+	void print_u8(uint64_t n);
+	void test_5g();
+	int  input_i32();
+	void powerCon(uint64_t na, int force);
+	int  __he_cpu_level();
+}
+
+static pair<const char*, void*> g_runtime_symbols[] = {
+	{"print_i32", (void*)&print_i32},
+	{"print_u8", (void*)&print_u8},
+	{"test_5g", (void*)&test_5g},
+	{"input_i32", (void*)&input_i32},
+	{"powerCon", (void*)&powerCon},
+	{"__he_cpu_level", (void*)&__he_cpu_level},
+	{"flush", (void*)&flush},
+};
+
+void* FindHostSymbol(const string& name)
+{
+	for (auto& [n, addr] : g_runtime_symbols)
+	{
+		if (name == n) return addr;
+	}
+	sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
+	return sys::DynamicLibrary::SearchForAddressOfSymbol(name);
+}
+
+static Error DefineHostSymbols(orc::LLJIT& jit)
+{
+	orc::JITDylib& main = jit.getMainJITDylib();
+	orc::MangleAndInterner mangle(jit.getExecutionSession(), jit.getDataLayout());
+	orc::SymbolMap runtime;
+	for (auto& [name, addr] : g_runtime_symbols)
+	{
+		runtime[mangle(name)] = JITEvaluatedSymbol(pointerToJITTargetAddress(addr),
+			JITSymbolFlags::Exported | JITSymbolFlags::Callable);
+	}
+	if (Error e = main.define(orc::absoluteSymbols(std::move(runtime))))
+	{
+		return e;
+	}
+	//other extern functions,e.g. from libc,are looked up in the process
+	auto process = orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(jit.getDataLayout().getGlobalPrefix());
+	if (!process)
+	{
+		return process.takeError();
+	}
+	main.addGenerator(std::move(*process));
+	return Error::success();
+}
+
+static Expected<unique_ptr<orc::LLJIT>> CreateHostJIT(Config& config, bool lazy)
+{
+	auto jtmb = orc::JITTargetMachineBuilder::detectHost();
+	if (!jtmb)
+	{
+		return jtmb.takeError();
+	}
+	//the functions carry the same cpu and features as attributes,see RecordTarget
+	jtmb->setCPU(config.cpu);
+	if (!config.features.empty())
+	{
+		jtmb->addFeatures({ config.features });
+	}
+
+	if (lazy)
+	{
+		auto jit = orc::LLLazyJITBuilder()
+			.setJITTargetMachineBuilder(std::move(*jtmb))
+			.setNumCompileThreads(config.jit_threads)
+			.create();
+		if (!jit)
+		{
+			return jit.takeError();
+		}
+		return unique_ptr<orc::LLJIT>(std::move(*jit));
+	}
+	return orc::LLJITBuilder()
+		.setJITTargetMachineBuilder(std::move(*jtmb))
+		.setNumCompileThreads(config.jit_threads)
+		.create();
+}
+
+Expected<unique_ptr<orc::LLJIT>> CreateJIT(Config& config, bool lazy)
+{
+	auto jit = CreateHostJIT(config, lazy);
+	if (!jit)
+	{
+		return jit.takeError();
+	}
+	if (Error e = DefineHostSymbols(**jit))
+	{
+		return std::move(e);
+	}
+	return jit;
+}
+
+optional<int> RunJIT(vector<ptr<LLVMCodeGenContext>>& modules, Config& config, string& error)
+{
+	auto jit = CreateJIT(config, config.jit_lazy);
+	if (!jit)
+	{
+		error = "fail to create jit : " + toString(jit.takeError());
+		return {};
+	}
+	orc::JITDylib& main = (*jit)->getMainJITDylib();
+
+	for (auto& m : modules)
+	{
+		m->llvm_module->setDataLayout((*jit)->getDataLayout());
+		orc::ThreadSafeModule tsm(std::move(m->llvm_module), std::move(m->llvm_context));
+		Error e = config.jit_lazy ?
+			static_cast<orc::LLLazyJIT&>(**jit).addLazyIRModule(std::move(tsm)) :
+			(*jit)->addIRModule(std::move(tsm));
+		if (e)
+		{
+			error = toString(std::move(e));
+			return {};
+		}
+	}
+
+	//module constructors,e.g. the multiversion resolvers
+	if (Error e = (*jit)->initialize(main))
+	{
+		error = toString(std::move(e));
+		return {};
+	}
+	auto entry = (*jit)->lookup("__he_entry_main");
+	if (!entry)
+	{
+		error = toString(entry.takeError());
+		return {};
+	}
+	int (*entry_main)() = jitTargetAddressToFunction<int (*)()>(entry->getAddress());
+	int rtv = entry_main();
+	flush();
+
+	if (Error e = (*jit)->deinitialize(main))
+	{
+		error = toString(std::move(e));
+		return {};
+	}
+	return rtv;
+}
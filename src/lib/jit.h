@@ -0,0 +1,17 @@
+#pragma once
+#include "codegen.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+
+//run the generated modules in process with orc,the runtime in template/ is linked into the
+//compiler and resolved as host symbols so no object file or linker is involved
+//the modules are moved into the jit,returns the value of __he_entry_main
+optional<int> RunJIT(vector<ptr<LLVMCodeGenContext>>& modules, Config& config, string& error);
+
+//jit for the host with the runtime and the symbols of the process defined
+llvm::Expected<unique_ptr<llvm::orc::LLJIT>> CreateJIT(Config& config, bool lazy);
+//address of a runtime or process function,nullptr if there is none
+void* FindHostSymbol(const string& name);
+
+//write what the runtime of this thread buffered,the host runs programs in process so a print is
+//seen before anything the compiler prints after the program
+extern "C" void flush();
@@ -0,0 +1,113 @@
+#include "jobserver.h"
+#include "server.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+unique_ptr<JobServer> JobServer::Connect(bool& unavailable) {
+	unavailable = false;
+	return nullptr;
+}
+
+JobServer::~JobServer() {}
+bool JobServer::Acquire(int wake) { return false; }
+bool JobServer::TryAcquire() { return false; }
+void JobServer::Release() {}
+
+#else
+
+//the last --jobserver-auth or --jobserver-fds of MAKEFLAGS,make appends the one it uses
+static optional<string> JobServerAuth() {
+	const char* flags = getenv("MAKEFLAGS");
+	if (flags == nullptr) {
+		return {};
+	}
+	string s = flags;
+	optional<string> auth;
+	for (const string key : { "--jobserver-auth=", "--jobserver-fds=" }) {
+		for (usize p = s.find(key); p != string::npos; p = s.find(key, p + 1)) {
+			usize e = s.find(' ', p);
+			auth = s.substr(p + key.size(), e == string::npos ? string::npos : e - p - key.size());
+		}
+		if (auth.has_value()) break;
+	}
+	return auth;
+}
+
+unique_ptr<JobServer> JobServer::Connect(bool& unavailable) {
+	unavailable = false;
+	auto auth = JobServerAuth();
+	if (!auth.has_value()) {
+		return nullptr;
+	}
+	int r = -1, w = -1;
+	if (auth->compare(0, 5, "fifo:") == 0) {
+		string path = auth->substr(5);
+		r = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		w = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+	}
+	else if (int fr, fw; sscanf(auth->c_str(), "%d,%d", &fr, &fw) == 2 && fcntl(fr, F_GETFD) >= 0 && fcntl(fw, F_GETFD) >= 0) {
+		//the pipe is shared with make and the other jobs,a descriptor of our own can be made
+		//non-blocking without changing theirs
+		r = open(("/proc/self/fd/" + to_string(fr)).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		w = fcntl(fw, F_DUPFD_CLOEXEC, 0);
+	}
+	if (r < 0 || w < 0) {
+		if (r >= 0) close(r);
+		if (w >= 0) close(w);
+		unavailable = true;
+		return nullptr;
+	}
+	return unique_ptr<JobServer>(new JobServer(r, w));
+}
+
+JobServer::~JobServer() {
+	while (!tokens.empty()) {
+		Release();
+	}
+	close(read_fd);
+	close(write_fd);
+}
+
+bool JobServer::TryAcquire() {
+	char c;
+	ssize_t n;
+	while ((n = read(read_fd, &c, 1)) < 0 && errno == EINTR);
+	if (n != 1) {
+		return false;
+	}
+	tokens.push_back(c);
+	return true;
+}
+
+bool JobServer::Acquire(int wake) {
+	while (!TryAcquire()) {
+		pollfd fds[2] = { { read_fd, POLLIN, 0 }, { wake, POLLIN, 0 } };
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		if (fds[1].revents != 0) {
+			return false;
+		}
+		//make has gone
+		if ((fds[0].revents & (POLLHUP | POLLERR)) != 0 && (fds[0].revents & POLLIN) == 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void JobServer::Release() {
+	if (tokens.empty()) {
+		return;
+	}
+	WriteAll(write_fd, &tokens.back(), 1);
+	tokens.pop_back();
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+#include "common.h"
+
+//client of the gnu make jobserver,a program started by make -j owns one implicit job and takes a
+//token from the jobserver for every other job it runs at the same time
+//make 4.3 passes MAKEFLAGS --jobserver-auth=<read fd>,<write fd>,make 4.4 --jobserver-auth=fifo:<path>
+class JobServer
+{
+public:
+	//nullptr if MAKEFLAGS names no jobserver,unavailable is set if it names one this process can't
+	//reach,make closes the descriptors of the commands of a rule unless they are marked with +
+	static unique_ptr<JobServer> Connect(bool& unavailable);
+	//the tokens still held are given back
+	~JobServer();
+
+	//wait for a token,returns false if wake becomes readable first
+	bool Acquire(int wake);
+	//take a token if one is free now
+	bool TryAcquire();
+	void Release();
+	u32  Held() { return tokens.size(); }
+
+private:
+	JobServer(int read_fd, int write_fd) : read_fd(read_fd), write_fd(write_fd) {}
+
+	//descriptors of this process,reads don't block
+	int read_fd, write_fd;
+	//make wants the bytes it handed out back
+	string tokens;
+};
@@ -0,0 +1,97 @@
+#include "link.h"
+#include "server.h"
+#include <cstring>
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+bool LinkExecutable(const vector<vector<char>>& objects, const string& runtime, const string& output, bool freestanding,
+	string& error) {
+	error = "the in-process link isn't supported on this platform";
+	return false;
+}
+
+#else
+
+extern char** environ;
+
+//an object in an anonymous memory file,the linker opens it by its /proc path
+struct MemoryFile {
+	int fd = -1;
+	~MemoryFile() {
+		if (fd >= 0) close(fd);
+	}
+	string Path() { return "/proc/self/fd/" + to_string(fd); }
+};
+
+//the linker runs in a child process,the files must survive exec
+static bool CreateMemoryFile(const vector<char>& data, MemoryFile& file, string& error) {
+	file.fd = memfd_create("helang.o", 0);
+	if (file.fd < 0) {
+		error = string("fail to create a memory file : ") + strerror(errno);
+		return false;
+	}
+	if (!WriteAll(file.fd, data.data(), data.size())) {
+		error = string("fail to write a memory file : ") + strerror(errno);
+		return false;
+	}
+	return true;
+}
+
+static bool LinkWithCompiler(const vector<string>& objects, const string& runtime, const string& output, bool freestanding,
+	string& error) {
+	const char* linker = getenv("HELANG_LINKER");
+	//helang-c generates code for the static relocation model,its objects can't go into a pie
+	vector<string> args = { linker != nullptr && *linker != '\0' ? linker : HELANG_LINKER, "-no-pie", "-o", output };
+	if (freestanding) {
+		args.insert(args.end(), { "-static", "-nostdlib" });
+	}
+	args.insert(args.end(), objects.begin(), objects.end());
+	args.push_back(runtime);
+	if (freestanding) {
+		args.push_back("-lgcc");
+	}
+
+	vector<char*> argv;
+	for (auto& a : args) {
+		argv.push_back(a.data());
+	}
+	argv.push_back(nullptr);
+	pid_t pid;
+	if (int e = posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ); e != 0) {
+		error = "fail to start the linker " + args[0] + " : " + strerror(e);
+		return false;
+	}
+	int status;
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			error = string("fail to wait for the linker : ") + strerror(errno);
+			return false;
+		}
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		error = "the linker " + args[0] + " fails";
+		return false;
+	}
+	return true;
+}
+
+bool LinkExecutable(const vector<vector<char>>& objects, const string& runtime, const string& output, bool freestanding,
+	string& error) {
+	vector<MemoryFile> files(objects.size());
+	vector<string> paths;
+	for (u32 i = 0; i < objects.size(); i++) {
+		if (!CreateMemoryFile(objects[i], files[i], error)) {
+			return false;
+		}
+		paths.push_back(files[i].Path());
+	}
+	return LinkWithCompiler(paths, runtime, output, freestanding, error);
+}
+
+#endif
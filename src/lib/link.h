@@ -0,0 +1,11 @@
+#pragma once
+#include "common.h"
+
+//link step of the helang driver on linux,nothing is written to disk but the executable
+//every object is handed to the linker as a memory file,/proc/self/fd/<n>
+//runtime is the archive of the precompiled runtime,libhelang_rt.a next to the driver
+//freestanding links a static executable with libhelang_rt_freestanding.a and no libc
+//the c compiler HELANG_LINKER(cc) links in one child process,HELANG_LINKER in the environment
+//overrides it
+bool LinkExecutable(const vector<vector<char>>& objects, const string& runtime, const string& output, bool freestanding,
+	string& error);
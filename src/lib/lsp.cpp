@@ -0,0 +1,650 @@
+#include "lsp.h"
+#include "interface.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <map>
+#include <unordered_set>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+using namespace llvm;
+
+static vector<string> SplitLines(const string& text)
+{
+	vector<string> lines(1);
+	for (usize i = 0; i < text.size(); i++)
+	{
+		if (text[i] == '\r' || text[i] == '\n')
+		{
+			if (text[i] == '\r' && i + 1 < text.size() && text[i + 1] == '\n') i++;
+			lines.emplace_back();
+		}
+		else
+		{
+			lines.back() += text[i];
+		}
+	}
+	return lines;
+}
+
+//parse errors are prefixed with their location,which the diagnostic carries already
+static string StripLocation(const string& error)
+{
+	const string prefix = "fail to parse ast error at (";
+	usize p = error.find(')');
+	if (error.compare(0, prefix.size(), prefix) != 0 || p == string::npos)
+	{
+		return error;
+	}
+	usize b = error.find_first_not_of(' ', p + 1);
+	return b == string::npos ? error : error.substr(b);
+}
+
+//"lexer : error at (line,column):message",the line is dropped since it moves with edits
+static LspDiagnostic LexerDiagnostic(const string& line, const string& error)
+{
+	LspDiagnostic d{ 0, 0, (u32)line.size(), error };
+	usize comma = error.find(','), close = error.find("):");
+	if (error.compare(0, 18, "lexer : error at (") != 0 || comma == string::npos || close == string::npos || comma > close)
+	{
+		return d;
+	}
+	d.start = min<u32>(stoul(error.substr(comma + 1, close - comma - 1)), line.size());
+	d.end = min<u32>(d.start + 1, line.size());
+	d.message = error.substr(close + 2);
+	//the lexer stops at the first byte of a utf-8 character,report the whole character
+	if (d.start < line.size() && (unsigned char)line[d.start] >= 0x80)
+	{
+		while (d.end < line.size() && ((unsigned char)line[d.end] & 0xc0) == 0x80) d.end++;
+		d.message = "unrecognized character \"" + line.substr(d.start, d.end - d.start) + "\"";
+	}
+	return d;
+}
+
+void LspDocument::Open(const string& text)
+{
+	lines = SplitLines(text);
+	tokens.assign(lines.size(), {});
+	lex_errors.assign(lines.size(), {});
+	lex_error_count = 0;
+	for (u32 l = 0; l < lines.size(); l++)
+	{
+		Lexer lexer;
+		if (auto v = lexer.ParseLine(lines[l], l + 1); v.has_value())
+		{
+			tokens[l] = std::move(v.value());
+		}
+		else
+		{
+			lex_errors[l] = LexerDiagnostic(lines[l], lexer.ErrorMsg());
+			lex_error_count++;
+		}
+	}
+	items.clear();
+	defined_in.clear();
+	called_in.clear();
+	items = Segment(0, 0, lines.size(), 0);
+	unordered_map<string, map<u32, i32>> changed;
+	for (auto& item : items)
+	{
+		Index(*item, true, changed);
+	}
+	for (auto& item : items)
+	{
+		Check(*item);
+	}
+}
+
+vector<ptr<LspDocument::Item>> LspDocument::Segment(u32 line, u32 index, u32 end_line, u32 end_index)
+{
+	//a function starts at fn,or at multiversion or ccnd which take the fn after them,a fn can't
+	//be inside another function so an unclosed body ends at the next one,an import is an item too
+	vector<ptr<Item>> result;
+	bool absorb = false;
+	for (u32 l = line; l < end_line || (l == end_line && l < lines.size()); l++)
+	{
+		u32 last = l == end_line ? end_index : tokens[l].size();
+		for (u32 i = l == line ? index : 0; i < last; i++)
+		{
+			HE_TOKEN_TYPE type = tokens[l][i].type;
+			bool starts = type == HE_TOKEN_EXTERN || type == HE_TOKEN_MULTIVERSION || type == HE_TOKEN_IMPORT ||
+				(type == HE_TOKEN_FUNC && !absorb);
+			if (result.empty() || starts)
+			{
+				result.push_back(make_shared<Item>());
+				result.back()->line = l;
+				result.back()->index = i;
+			}
+			absorb = type == HE_TOKEN_EXTERN || type == HE_TOKEN_MULTIVERSION;
+		}
+	}
+	for (u32 k = 0; k < result.size(); k++)
+	{
+		if (k + 1 < result.size())
+		{
+			Parse(*result[k], result[k + 1]->line, result[k + 1]->index);
+		}
+		else
+		{
+			Parse(*result[k], end_line, end_index);
+		}
+	}
+	return result;
+}
+
+void LspDocument::Parse(Item& item, u32 end_line, u32 end_index)
+{
+	vector<Token> slice;
+	for (u32 l = item.line; l < end_line || (l == end_line && l < lines.size()); l++)
+	{
+		u32 last = l == end_line ? end_index : tokens[l].size();
+		for (u32 i = l == item.line ? item.index : 0; i < last; i++)
+		{
+			slice.push_back(tokens[l][i]);
+			slice.back().line = l + 1;
+		}
+	}
+
+	AST ast;
+	if (!ast.Parse(slice))
+	{
+		const Token& at = ast.ErrorToken().has_value() ? ast.ErrorToken().value() : slice.front();
+		item.parse_errors.push_back({ at.line - 1, at.start, at.end, StripLocation(ast.ErrorMsg()) });
+		//the signature of a function being edited still counts,its callers are checked against it
+		auto lcurly = find_if(slice.begin(), slice.end(), [](Token& t) { return t.type == HE_TOKEN_LCURLY; });
+		if (slice.front().type == HE_TOKEN_EXTERN || slice.front().type == HE_TOKEN_IMPORT || lcurly == slice.end())
+		{
+			return;
+		}
+		vector<Token> signature(slice.begin(), lcurly + 1);
+		Token close = *lcurly;
+		close.type = HE_TOKEN_RCURLY;
+		close.token = "}";
+		signature.push_back(close);
+		if (!ast.Parse(signature))
+		{
+			return;
+		}
+	}
+
+	//the functions of an imported module count as definitions of the import,a document that
+	//isn't a file can't import
+	for (auto& t : ast.Imports())
+	{
+		string error;
+		auto sigs = path.empty() ? nullopt : LoadInterface(ModuleSource(path, t.token), false, error);
+		if (!sigs.has_value())
+		{
+			item.parse_errors.push_back({ t.line - 1, t.start, t.end,
+				path.empty() ? "import needs a file:// document" : error });
+			continue;
+		}
+		for (auto& sig : sigs.value())
+		{
+			item.defs.push_back({ sig->GetName(), (u32)sig->GetArgs().size() });
+		}
+	}
+
+	vector<ptr<SignatureExpr>> defined, declared;
+	ast.Signatures(defined, declared);
+	for (auto& sig : declared)
+	{
+		item.defs.push_back({ sig->GetName(), (u32)sig->GetArgs().size() });
+	}
+	for (auto& f : ast.Functions())
+	{
+		ptr<SignatureExpr> sig = f->GetSignature();
+		item.defs.push_back({ sig->GetName(), (u32)sig->GetArgs().size() });
+		item.funcs.push_back(sig->GetName());
+		vector<CallExpr*> calls;
+		f->CollectCalls(calls);
+		for (auto call : calls)
+		{
+			item.calls.push_back({ call->GetFunc(), (u32)call->GetArgs().size(),
+				{ call->GetLine() - 1, call->GetStart(), call->GetEnd(), "" } });
+		}
+	}
+}
+
+//changed counts the argument counts added and removed per function name
+void LspDocument::Index(Item& item, bool add, unordered_map<string, map<u32, i32>>& changed)
+{
+	auto update = [&](vector<Item*>& v) {
+		if (add)
+		{
+			v.push_back(&item);
+		}
+		else
+		{
+			v.erase(std::find(v.begin(), v.end(), &item));
+		}
+	};
+	for (auto& [name, args] : item.defs)
+	{
+		update(defined_in[name]);
+		changed[name][args] += add ? 1 : -1;
+	}
+	//an item calling a function twice is listed once
+	unordered_set<string> called;
+	for (auto& call : item.calls)
+	{
+		if (called.insert(call.name).second)
+		{
+			update(called_in[call.name]);
+		}
+	}
+}
+
+void LspDocument::Check(Item& item)
+{
+	item.check_errors.clear();
+	for (auto& call : item.calls)
+	{
+		auto v = defined_in.find(call.name);
+		if (v == defined_in.end() || v->second.empty())
+		{
+			item.check_errors.push_back(call.location);
+			item.check_errors.back().message = "invalid function call,function " + call.name + "'s definition is not found";
+			continue;
+		}
+		for (auto& [name, args] : v->second.front()->defs)
+		{
+			if (name == call.name && args != call.args)
+			{
+				item.check_errors.push_back(call.location);
+				item.check_errors.back().message = "function call expect " + to_string(args) + " arguments but " +
+					to_string(call.args) + " was found";
+				break;
+			}
+		}
+	}
+	for (auto& name : item.funcs)
+	{
+		u32 count = 0;
+		for (Item* other : defined_in[name])
+		{
+			count += std::count(other->funcs.begin(), other->funcs.end(), name);
+		}
+		if (count > 1)
+		{
+			const Token& t = tokens[item.line][item.index];
+			item.check_errors.push_back({ item.line, t.start, t.end, "function " + name + " is defined more than once" });
+		}
+	}
+}
+
+void LspDocument::Edit(u32 start_line, u32 start_column, u32 end_line, u32 end_column, const string& text)
+{
+	end_line = min<u32>(end_line, lines.size() - 1);
+	start_line = min<u32>(start_line, end_line);
+	start_column = min<u32>(start_column, lines[start_line].size());
+	end_column = min<u32>(end_column, lines[end_line].size());
+	vector<string> replaced = SplitLines(lines[start_line].substr(0, start_column) + text + lines[end_line].substr(end_column));
+	i32 delta = (i32)replaced.size() - (i32)(end_line - start_line + 1);
+
+	//lex the new lines only
+	for (u32 l = start_line; l <= end_line; l++)
+	{
+		lex_error_count -= lex_errors[l].has_value();
+	}
+	vector<vector<Token>> replaced_tokens(replaced.size());
+	vector<optional<LspDiagnostic>> replaced_errors(replaced.size());
+	for (u32 k = 0; k < replaced.size(); k++)
+	{
+		Lexer lexer;
+		if (auto v = lexer.ParseLine(replaced[k], start_line + k + 1); v.has_value())
+		{
+			replaced_tokens[k] = std::move(v.value());
+		}
+		else
+		{
+			replaced_errors[k] = LexerDiagnostic(replaced[k], lexer.ErrorMsg());
+			lex_error_count++;
+		}
+	}
+	auto splice = [&](auto& v, auto& with) {
+		v.erase(v.begin() + start_line, v.begin() + end_line + 1);
+		v.insert(v.begin() + start_line, std::make_move_iterator(with.begin()), std::make_move_iterator(with.end()));
+	};
+	splice(lines, replaced);
+	splice(tokens, replaced_tokens);
+	splice(lex_errors, replaced_errors);
+
+	//the item before the edit may reach into it,the items starting in it are parsed again,the
+	//ones after it keep their ast and move by delta lines
+	u32 first = lower_bound(items.begin(), items.end(), start_line, [](const ptr<Item>& i, u32 l) { return i->line < l; }) - items.begin();
+	u32 last = upper_bound(items.begin(), items.end(), end_line, [](u32 l, const ptr<Item>& i) { return l < i->line; }) - items.begin();
+	if (first > 0) first--;
+	for (u32 k = last; k < items.size(); k++)
+	{
+		Item& item = *items[k];
+		item.line += delta;
+		for (auto& d : item.parse_errors) d.line += delta;
+		for (auto& d : item.check_errors) d.line += delta;
+		for (auto& c : item.calls) c.location.line += delta;
+	}
+	//the next item can't start with a fn taken by a ccnd or multiversion at the end of the edit,
+	//nor at a token other than fn,ccnd,multiversion or import unless it is still the first in the document
+	auto taken = [&](u32 k) {
+		HE_TOKEN_TYPE first_type = tokens[items[k]->line][items[k]->index].type;
+		if (first_type != HE_TOKEN_FUNC && first_type != HE_TOKEN_EXTERN && first_type != HE_TOKEN_MULTIVERSION &&
+			first_type != HE_TOKEN_IMPORT)
+		{
+			return true;
+		}
+		for (i32 l = items[k]->line, i = items[k]->index; l >= 0; l--, i = l >= 0 ? tokens[l].size() : 0)
+		{
+			if (i > 0)
+			{
+				HE_TOKEN_TYPE type = tokens[l][i - 1].type;
+				return type == HE_TOKEN_EXTERN || type == HE_TOKEN_MULTIVERSION;
+			}
+		}
+		return false;
+	};
+	while (last < items.size() && taken(last))
+	{
+		last++;
+	}
+
+	//the first item starts at the first token of the document,which may be in the edit
+	u32 line = first > 0 ? items[first]->line : 0;
+	u32 index = first > 0 ? items[first]->index : 0;
+	u32 stop_line = last < items.size() ? items[last]->line : lines.size();
+	u32 stop_index = last < items.size() ? items[last]->index : 0;
+	vector<ptr<Item>> parsed = Segment(line, index, stop_line, stop_index);
+
+	unordered_map<string, map<u32, i32>> changed;
+	for (u32 k = first; k < last; k++)
+	{
+		Index(*items[k], false, changed);
+	}
+	items.erase(items.begin() + first, items.begin() + last);
+	items.insert(items.begin() + first, parsed.begin(), parsed.end());
+	for (auto& item : parsed)
+	{
+		Index(*item, true, changed);
+	}
+
+	//the new items,and the callers and other definitions of the functions whose argument counts changed
+	unordered_set<Item*> check;
+	for (auto& item : parsed)
+	{
+		check.insert(item.get());
+	}
+	for (auto& [name, counts] : changed)
+	{
+		if (all_of(counts.begin(), counts.end(), [](auto& c) { return c.second == 0; }))
+		{
+			continue;
+		}
+		for (auto* index : { &called_in, &defined_in })
+		{
+			if (auto v = index->find(name); v != index->end())
+			{
+				check.insert(v->second.begin(), v->second.end());
+			}
+		}
+	}
+	for (Item* item : check)
+	{
+		Check(*item);
+	}
+}
+
+vector<LspDiagnostic> LspDocument::Diagnostics()
+{
+	vector<LspDiagnostic> result;
+	if (lex_error_count > 0)
+	{
+		for (u32 l = 0; l < lines.size(); l++)
+		{
+			if (lex_errors[l].has_value())
+			{
+				result.push_back(lex_errors[l].value());
+				result.back().line = l;
+			}
+		}
+	}
+	for (auto& item : items)
+	{
+		result.insert(result.end(), item->parse_errors.begin(), item->parse_errors.end());
+		result.insert(result.end(), item->check_errors.begin(), item->check_errors.end());
+	}
+	return result;
+}
+
+//lsp positions count utf-16 code units,the lexer counts bytes of utf-8
+static u32 Utf16ToByte(const string& line, int64_t units)
+{
+	u32 p = 0;
+	while (p < line.size() && units > 0)
+	{
+		unsigned char c = line[p];
+		u32 size = c < 0x80 ? 1 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : 4;
+		units -= size == 4 ? 2 : 1;
+		p = min<u32>(p + size, line.size());
+	}
+	return p;
+}
+
+static u32 ByteToUtf16(const string& line, u32 bytes)
+{
+	u32 units = 0;
+	for (u32 p = 0; p < bytes && p < line.size(); p++)
+	{
+		unsigned char c = line[p];
+		if ((c & 0xc0) != 0x80) units += c >= 0xf0 ? 2 : 1;
+	}
+	return units;
+}
+
+static optional<string> ReadMessage()
+{
+	usize length = 0;
+	string header;
+	int c;
+	while ((c = getchar()) != EOF)
+	{
+		if (c != '\n')
+		{
+			if (c != '\r') header += (char)c;
+			continue;
+		}
+		if (header.empty())
+		{
+			string body(length, '\0');
+			if (fread(body.data(), 1, length, stdin) != length) return {};
+			return body;
+		}
+		const string key = "Content-Length:";
+		if (header.compare(0, key.size(), key) == 0)
+		{
+			length = strtoull(header.c_str() + key.size(), nullptr, 10);
+		}
+		header.clear();
+	}
+	return {};
+}
+
+static void WriteMessage(json::Value message)
+{
+	string body;
+	raw_string_ostream os(body);
+	os << message;
+	os.flush();
+	printf("Content-Length: %zu\r\n\r\n", body.size());
+	fwrite(body.data(), 1, body.size(), stdout);
+	fflush(stdout);
+}
+
+//path of a file:// uri,empty for other schemes
+static string FilePath(const string& uri)
+{
+	const string scheme = "file://";
+	if (uri.compare(0, scheme.size(), scheme) != 0)
+	{
+		return "";
+	}
+	string path;
+	for (usize i = scheme.size(); i < uri.size(); i++)
+	{
+		if (uri[i] == '%' && i + 2 < uri.size() && isxdigit((unsigned char)uri[i + 1]) && isxdigit((unsigned char)uri[i + 2]))
+		{
+			path += (char)stoi(uri.substr(i + 1, 2), nullptr, 16);
+			i += 2;
+		}
+		else
+		{
+			path += uri[i];
+		}
+	}
+#ifdef _WIN32
+	//file:///c:/dir
+	if (path.size() > 2 && path[0] == '/' && path[2] == ':') path.erase(0, 1);
+#endif
+	return path;
+}
+
+static void Publish(const string& uri, LspDocument* document)
+{
+	json::Array diagnostics;
+	if (document != nullptr)
+	{
+		auto& lines = document->Lines();
+		for (auto& d : document->Diagnostics())
+		{
+			const string& line = d.line < lines.size() ? lines[d.line] : "";
+			json::Object range{
+				{"start", json::Object{{"line", d.line}, {"character", ByteToUtf16(line, d.start)}}},
+				{"end", json::Object{{"line", d.line}, {"character", ByteToUtf16(line, d.end)}}},
+			};
+			diagnostics.push_back(json::Object{
+				{"range", std::move(range)}, {"severity", 1}, {"source", "helang"}, {"message", json::isUTF8(d.message) ? d.message : json::fixUTF8(d.message)} });
+		}
+	}
+	WriteMessage(json::Object{
+		{"jsonrpc", "2.0"},
+		{"method", "textDocument/publishDiagnostics"},
+		{"params", json::Object{{"uri", uri}, {"diagnostics", std::move(diagnostics)}}},
+	});
+}
+
+int RunLanguageServer()
+{
+#ifdef _WIN32
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	map<string, LspDocument> documents;
+	bool shutdown = false;
+	while (auto text = ReadMessage())
+	{
+		Expected<json::Value> message = json::parse(text.value());
+		if (!message)
+		{
+			consumeError(message.takeError());
+			continue;
+		}
+		json::Object* m = message->getAsObject();
+		if (m == nullptr) continue;
+		string method = m->getString("method").getValueOr("").str();
+		json::Value* id = m->get("id");
+		json::Object* params = m->getObject("params");
+		//a malformed message is answered with an error,the id is null if it has none
+		auto fail = [&](i32 code, const string& error) {
+			WriteMessage(json::Object{ {"jsonrpc", "2.0"}, {"id", id != nullptr ? *id : json::Value(nullptr)},
+				{"error", json::Object{{"code", code}, {"message", error}}} });
+		};
+		auto reply = [&](json::Value result) {
+			if (id == nullptr)
+			{
+				//InvalidRequest
+				fail(-32600, "the request " + method + " has no id");
+				return;
+			}
+			WriteMessage(json::Object{ {"jsonrpc", "2.0"}, {"id", *id}, {"result", std::move(result)} });
+		};
+		auto uri = [&](json::Object* doc) { return doc != nullptr ? doc->getString("uri").getValueOr("").str() : string(); };
+
+		if (method == "initialize")
+		{
+			reply(json::Object{
+				{"capabilities", json::Object{
+					//incremental changes
+					{"textDocumentSync", json::Object{{"openClose", true}, {"change", 2}}},
+				}},
+				{"serverInfo", json::Object{{"name", "helang"}}},
+			});
+		}
+		else if (method == "shutdown")
+		{
+			shutdown = true;
+			reply(nullptr);
+		}
+		else if (method == "exit")
+		{
+			return shutdown ? 0 : 1;
+		}
+		else if (method == "textDocument/didOpen")
+		{
+			json::Object* doc = params != nullptr ? params->getObject("textDocument") : nullptr;
+			if (doc == nullptr)
+			{
+				//InvalidParams
+				fail(-32602, "textDocument/didOpen needs params.textDocument");
+				continue;
+			}
+			string name = uri(doc);
+			documents[name].SetPath(FilePath(name));
+			documents[name].Open(doc->getString("text").getValueOr("").str());
+			Publish(name, &documents[name]);
+		}
+		else if (method == "textDocument/didChange" && params != nullptr)
+		{
+			string name = uri(params->getObject("textDocument"));
+			auto v = documents.find(name);
+			json::Array* changes = params->getArray("contentChanges");
+			if (v == documents.end() || changes == nullptr) continue;
+			LspDocument& document = v->second;
+			for (auto& change : *changes)
+			{
+				json::Object* c = change.getAsObject();
+				if (c == nullptr) continue;
+				string text = c->getString("text").getValueOr("").str();
+				json::Object* range = c->getObject("range");
+				if (range == nullptr)
+				{
+					document.Open(text);
+					continue;
+				}
+				auto position = [&](const char* key, u32& line, u32& column) {
+					json::Object* p = range->getObject(key);
+					line = p != nullptr ? p->getInteger("line").getValueOr(0) : 0;
+					line = min<u32>(line, document.Lines().size() - 1);
+					column = Utf16ToByte(document.Lines()[line], p != nullptr ? p->getInteger("character").getValueOr(0) : 0);
+				};
+				u32 start_line, start_column, end_line, end_column;
+				position("start", start_line, start_column);
+				position("end", end_line, end_column);
+				document.Edit(start_line, start_column, end_line, end_column, text);
+			}
+			Publish(name, &document);
+		}
+		else if (method == "textDocument/didClose" && params != nullptr)
+		{
+			string name = uri(params->getObject("textDocument"));
+			documents.erase(name);
+			Publish(name, nullptr);
+		}
+		else if (id != nullptr)
+		{
+			//MethodNotFound
+			fail(-32601, "method not found : " + method);
+		}
+	}
+	return shutdown ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "ast.h"
+#include <map>
+#include <unordered_map>
+
+//language server over stdio,helang-c --lsp
+//a document keeps the tokens of every line and the ast of every top-level item,an item is a
+//function,an extern declaration or an import with the tokens up to the next one,an edit lexes the changed
+//lines again and parses the items they touch,the calls of the parsed items and of the items
+//calling a function whose signature changed are checked again
+
+struct LspDiagnostic
+{
+	//0-based line,byte columns
+	u32 line, start, end;
+	string message;
+};
+
+class LspDocument
+{
+public:
+	void Open(const string& text);
+	//the file of the document,modules it imports are looked up next to it
+	void SetPath(const string& file) { path = file; }
+	//replace the text between two positions,columns are in bytes
+	void Edit(u32 start_line, u32 start_column, u32 end_line, u32 end_column, const string& text);
+	vector<LspDiagnostic> Diagnostics();
+
+	const vector<string>& Lines() { return lines; }
+
+private:
+	struct Call
+	{
+		string name;
+		u32 args;
+		LspDiagnostic location;
+	};
+	struct Item
+	{
+		//position of the first token
+		u32 line, index;
+		vector<LspDiagnostic> parse_errors;
+		vector<LspDiagnostic> check_errors;
+		//functions defined with their argument count,extern declarations count as definitions
+		vector<pair<string, u32>> defs;
+		vector<string> funcs;
+		vector<Call> calls;
+	};
+
+	//split tokens from (line,index) up to (end_line,end_index) into items and parse them
+	vector<ptr<Item>> Segment(u32 line, u32 index, u32 end_line, u32 end_index);
+	void Parse(Item& item, u32 end_line, u32 end_index);
+	void Index(Item& item, bool add, unordered_map<string, map<u32, i32>>& changed);
+	void Check(Item& item);
+
+	string path;
+	vector<string> lines;
+	vector<vector<Token>> tokens;
+	//the line of a lexer error is the index it is kept at
+	vector<optional<LspDiagnostic>> lex_errors;
+	u32 lex_error_count = 0;
+	//items in document order
+	vector<ptr<Item>> items;
+	//argument counts of the functions by name,and the items defining and calling them
+	unordered_map<string, vector<Item*>> defined_in;
+	unordered_map<string, vector<Item*>> called_in;
+};
+
+int RunLanguageServer();
@@ -0,0 +1,168 @@
+#include "lto.h"
+#include <map>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/LTO/LTO.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Caching.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+bool ThinLink(const vector<string>& inputs, const string& prefix, const string& cache_dir, u32 jobs,
+	vector<string>& objects, string& error)
+{
+	vector<pair<string, vector<char>>> buffers;
+	for (auto& input : inputs)
+	{
+		auto buffer = MemoryBuffer::getFile(input);
+		if (!buffer)
+		{
+			error = "fail to load bitcode file " + input + " : " + buffer.getError().message();
+			return false;
+		}
+		StringRef data = (*buffer)->getBuffer();
+		buffers.emplace_back(input, vector<char>(data.begin(), data.end()));
+	}
+
+	vector<vector<char>> native;
+	if (!ThinLinkBuffers(buffers, cache_dir, jobs, native, error))
+	{
+		return false;
+	}
+	for (u32 task = 0; task < native.size(); task++)
+	{
+		string file = prefix + "." + to_string(task) + ".o";
+		std::error_code EC;
+		raw_fd_ostream os(file, EC);
+		if (EC)
+		{
+			error = "can't open file " + file;
+			return false;
+		}
+		os.write(native[task].data(), native[task].size());
+		objects.push_back(file);
+	}
+	return true;
+}
+
+bool ThinLinkBuffers(const vector<pair<string, vector<char>>>& inputs, const string& cache_dir, u32 jobs,
+	vector<vector<char>>& objects, string& error)
+{
+	lto::Config conf;
+	conf.DefaultTriple = sys::getDefaultTargetTriple();
+	conf.OptLevel = 2;
+	conf.CGOptLevel = CodeGenOpt::Default;
+
+	ThreadPoolStrategy strategy = heavyweight_hardware_concurrency(jobs);
+	lto::LTO lto(std::move(conf), lto::createInProcessThinBackend(strategy));
+
+	vector<unique_ptr<lto::InputFile>> files;
+	for (auto& [input, data] : inputs)
+	{
+		auto file = lto::InputFile::create(MemoryBufferRef(StringRef(data.data(), data.size()), input));
+		if (!file)
+		{
+			error = "fail to read bitcode file " + input + " : " + toString(file.takeError());
+			return false;
+		}
+		files.push_back(std::move(*file));
+	}
+
+	//a strong definition prevails over the linkonce_odr copies of the runtime the modules carry,
+	//otherwise the first copy does
+	map<string, pair<u32, bool>> prevailing;
+	for (u32 i = 0; i < files.size(); i++)
+	{
+		for (auto& sym : files[i]->symbols())
+		{
+			if (sym.isUndefined()) continue;
+			auto [it, inserted] = prevailing.try_emplace(sym.getName().str(), i, sym.isWeak());
+			if (inserted) continue;
+			if (!it->second.second && !sym.isWeak())
+			{
+				error = "duplicate definition of " + sym.getName().str() + " in " + inputs[i].first;
+				return false;
+			}
+			if (it->second.second && !sym.isWeak())
+			{
+				it->second = { i, false };
+			}
+		}
+	}
+
+	for (u32 i = 0; i < files.size(); i++)
+	{
+		auto& file = files[i];
+		auto& input = inputs[i].first;
+		vector<lto::SymbolResolution> resolutions;
+		for (auto& sym : file->symbols())
+		{
+			lto::SymbolResolution res;
+			if (!sym.isUndefined() && prevailing[sym.getName().str()].first == i)
+			{
+				res.Prevailing = true;
+				res.FinalDefinitionInLinkageUnit = true;
+			}
+			//the runtime only calls the entry point,every other helang function can be
+			//internalized and dropped once it is inlined everywhere
+			//the linkonce_odr copies of the runtime are the ones libhelang_rt.a defines and main.c
+			//calls,they stay visible so the executable keeps one __he_output and one flush
+			res.VisibleToRegularObj = sym.isUndefined() || sym.isWeak() || sym.getName() == "__he_entry_main";
+			resolutions.push_back(res);
+		}
+
+		if (Error e = lto.add(std::move(file), resolutions))
+		{
+			error = "fail to add " + input + " to the link : " + toString(std::move(e));
+			return false;
+		}
+	}
+
+	//the backends write to strings owned by the streams,every task writes its own
+	vector<SmallString<0>> results(lto.getMaxTasks());
+	vector<u8> written(lto.getMaxTasks(), 0);
+	AddStreamFn add_stream = [&](unsigned task) -> Expected<unique_ptr<CachedFileStream>> {
+		written[task] = 1;
+		return make_unique<CachedFileStream>(make_unique<raw_svector_ostream>(results[task]));
+	};
+
+	FileCache cache;
+	if (!cache_dir.empty())
+	{
+		//a cache hit hands back the object of an earlier link
+		auto add_buffer = [&](unsigned task, unique_ptr<MemoryBuffer> mb) {
+			written[task] = 1;
+			results[task] = mb->getBuffer();
+		};
+		if (auto c = localCache("ThinLTO", "Thin", cache_dir, add_buffer))
+		{
+			cache = std::move(*c);
+		}
+		else
+		{
+			error = "fail to open thinlto cache " + cache_dir + " : " + toString(c.takeError());
+			return false;
+		}
+	}
+
+	if (Error e = lto.run(add_stream, cache))
+	{
+		error = "thinlto link fails : " + toString(std::move(e));
+		return false;
+	}
+
+	if (!cache_dir.empty())
+	{
+		pruneCache(cache_dir, CachePruningPolicy{});
+	}
+
+	for (u32 task = 0; task < results.size(); task++)
+	{
+		if (written[task]) objects.emplace_back(results[task].begin(), results[task].end());
+	}
+	return true;
+}
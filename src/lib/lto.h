@@ -0,0 +1,14 @@
+#pragma once
+#include "common.h"
+
+//ThinLTO link step of the helang driver
+//the bitcode files written by helang-c --emit=bc are linked with cross-module importing and
+//their backends run in parallel,the native objects are written to <prefix>.<task>.o and
+//returned in objects,ready to be linked with the runtime
+//when cache_dir isn't empty backend results are cached there so unchanged modules relink cheaply
+bool ThinLink(const vector<string>& inputs, const string& prefix, const string& cache_dir, u32 jobs,
+	vector<string>& objects, string& error);
+//the same link in memory,inputs are pairs of name and bitcode and the native objects are
+//returned in objects
+bool ThinLinkBuffers(const vector<pair<string, vector<char>>>& inputs, const string& cache_dir, u32 jobs,
+	vector<vector<char>>& objects, string& error);
@@ -0,0 +1,148 @@
+#include "codegen.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+using namespace llvm;
+
+//function multiversioning
+//a multiversioned function is cloned once per x86-64 micro-architecture level,the original
+//function becomes a thin dispatcher calling through a slot which a module constructor fills
+//with the best clone for the cpu reported by __he_cpu_level in template/cpu.c
+
+struct MicroArchLevel
+{
+	const char* name;
+	const char* cpu;
+	const char* features;
+	u32         level;
+};
+
+#define HE_X86_64_V2_FEATURES "+cx16,+popcnt,+sahf,+sse3,+sse4.1,+sse4.2,+ssse3"
+#define HE_X86_64_V3_FEATURES HE_X86_64_V2_FEATURES ",+avx,+avx2,+bmi,+bmi2,+f16c,+fma,+lzcnt,+movbe,+xsave"
+#define HE_X86_64_V4_FEATURES HE_X86_64_V3_FEATURES ",+avx512f,+avx512bw,+avx512cd,+avx512dq,+avx512vl"
+
+static MicroArchLevel g_micro_arch_levels[] = {
+	{"v2", "x86-64-v2", HE_X86_64_V2_FEATURES, 2},
+	{"v3", "x86-64-v3", HE_X86_64_V3_FEATURES, 3},
+	{"v4", "x86-64-v4", HE_X86_64_V4_FEATURES, 4},
+};
+
+bool IsMicroArchLevel(const string& name)
+{
+	for (auto& l : g_micro_arch_levels)
+	{
+		if (name == l.name) return true;
+	}
+	return false;
+}
+
+bool LLVMCodeGenContext::GenerateMultiversion(Function* func, string& error)
+{
+	if (Triple(llvm_module->getTargetTriple()).getArch() != Triple::x86_64)
+	{
+		log += "helang: warning: multiversioning is only supported on x86-64," + func->getName().str() + " is compiled once\n";
+		return true;
+	}
+
+	Dispatch dispatch;
+	string name = func->getName().str();
+
+	ValueToValueMapTy default_map;
+	Function* fallback = CloneFunction(func, default_map);
+	fallback->setName(name + ".default");
+	fallback->setLinkage(Function::InternalLinkage);
+	dispatch.fallback = fallback;
+
+	vector<Function*> clones{ fallback };
+	for (auto& l : g_micro_arch_levels)
+	{
+		if (find(multiversion_levels.begin(), multiversion_levels.end(), l.name) == multiversion_levels.end())
+		{
+			continue;
+		}
+		ValueToValueMapTy map;
+		Function* clone = CloneFunction(func, map);
+		clone->setName(name + "." + l.name);
+		clone->setLinkage(Function::InternalLinkage);
+		clone->addFnAttr("target-cpu", l.cpu);
+		clone->addFnAttr("target-features", l.features);
+		dispatch.clones.push_back({ l.level, clone });
+		clones.push_back(clone);
+	}
+
+	//recursion stays inside the clone instead of going through the dispatcher again
+	for (Function* clone : clones)
+	{
+		for (auto& bb : *clone)
+		{
+			for (auto& inst : bb)
+			{
+				if (CallInst* call = dyn_cast<CallInst>(&inst); call != nullptr && call->getCalledFunction() == func)
+				{
+					call->setCalledFunction(clone);
+				}
+			}
+		}
+	}
+
+	dispatch.slot = new GlobalVariable(*llvm_module, func->getType(), false, GlobalValue::InternalLinkage,
+		fallback, name + ".slot");
+
+	func->deleteBody();
+	IRBuilder<> builder(BasicBlock::Create(*llvm_context, "dispatch", func));
+	Value* target = builder.CreateLoad(func->getType(), dispatch.slot);
+	vector<Value*> args;
+	for (auto& arg : func->args())
+	{
+		args.push_back(&arg);
+	}
+	CallInst* call = builder.CreateCall(func->getFunctionType(), target, args);
+	call->setTailCallKind(CallInst::TCK_MustTail);
+	if (func->getReturnType()->isVoidTy())
+	{
+		builder.CreateRetVoid();
+	}
+	else
+	{
+		builder.CreateRet(call);
+	}
+
+	raw_string_ostream ss(error);
+	if (verifyFunction(*func, &ss))
+	{
+		return false;
+	}
+	dispatch_table.push_back(dispatch);
+	return true;
+}
+
+void LLVMCodeGenContext::GenerateDispatchResolver()
+{
+	if (dispatch_table.empty())
+	{
+		return;
+	}
+
+	FunctionType* level_type = FunctionType::get(Type::getInt32Ty(*llvm_context), false);
+	FunctionCallee cpu_level = llvm_module->getOrInsertFunction("__he_cpu_level", level_type);
+
+	Function* resolver = Function::Create(FunctionType::get(Type::getVoidTy(*llvm_context), false),
+		Function::InternalLinkage, "__he_multiversion_resolve", *llvm_module);
+	IRBuilder<> builder(BasicBlock::Create(*llvm_context, "resolve", resolver));
+	Value* level = builder.CreateCall(cpu_level);
+	for (auto& d : dispatch_table)
+	{
+		//clones are ordered by ascending level so the last one supported wins
+		Value* target = d.fallback;
+		for (auto& [l, clone] : d.clones)
+		{
+			Value* supported = builder.CreateICmpUGE(level, ConstantInt::get(Type::getInt32Ty(*llvm_context), l));
+			target = builder.CreateSelect(supported, clone, target);
+		}
+		builder.CreateStore(target, d.slot);
+	}
+	builder.CreateRetVoid();
+
+	appendToGlobalCtors(*llvm_module, resolver, 0);
+}
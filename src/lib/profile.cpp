@@ -0,0 +1,192 @@
+#include "codegen.h"
+#include "io.h"
+#include "llvm/IR/MDBuilder.h"
+#include "llvm/ProfileData/InstrProf.h"
+#include "llvm/ProfileData/ProfileCommon.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+#include <sstream>
+
+using namespace llvm;
+
+//profile guided optimization
+//an instrumented function counts its entries and,for every conditional branch,how often the
+//branch is executed and taken,the counters of a module live in one array registered with
+//__he_profile_register in template/main.c,which writes them to HELANG_PROFILE at exit
+//
+//the profile is a text file,one line per function
+//  helang-profile 1
+//  <key> <count> <entry> <executed> <taken> ...
+//functions with external linkage are keyed by their name,internal ones by source:name
+
+static string ProfileKey(Function& func)
+{
+	if (func.hasLocalLinkage())
+	{
+		return func.getParent()->getSourceFileName() + ":" + func.getName().str();
+	}
+	return func.getName().str();
+}
+
+//conditional branches in block order,both the instrumented and the optimized build see the same
+static vector<BranchInst*> ConditionalBranches(Function& func)
+{
+	vector<BranchInst*> branches;
+	for (auto& bb : func)
+	{
+		if (BranchInst* br = dyn_cast<BranchInst>(bb.getTerminator()); br != nullptr && br->isConditional())
+		{
+			branches.push_back(br);
+		}
+	}
+	return branches;
+}
+
+optional<Profile> Profile::Load(const string& path, string& error)
+{
+	string content;
+	if (auto v = IO::Get().LoadFile(path); v.has_value())
+	{
+		content = v.value();
+	}
+	else
+	{
+		error = "fail to load profile " + path;
+		return {};
+	}
+
+	stringstream ss(content);
+	string magic;
+	u32 version = 0;
+	ss >> magic >> version;
+	if (magic != "helang-profile" || version != 1)
+	{
+		error = path + " is not a helang profile";
+		return {};
+	}
+
+	Profile profile;
+	string key;
+	u32 count;
+	while (ss >> key >> count)
+	{
+		vector<u64>& counters = profile.counters[key];
+		counters.resize(count);
+		for (auto& c : counters)
+		{
+			if (!(ss >> c))
+			{
+				error = "profile " + path + " is truncated at " + key;
+				return {};
+			}
+		}
+	}
+	return profile;
+}
+
+void LLVMCodeGenContext::GenerateProfileCounters()
+{
+	Type* i64 = Type::getInt64Ty(*llvm_context);
+
+	struct Instrumented
+	{
+		Function* func;
+		vector<BranchInst*> branches;
+		u32 base;
+	};
+	vector<Instrumented> funcs;
+	string layout;
+	u32 count = 0;
+	for (auto& f : *llvm_module)
+	{
+		if (f.isDeclaration()) continue;
+		Instrumented inst{ &f, ConditionalBranches(f), count };
+		u32 n = 1 + 2 * inst.branches.size();
+		layout += ProfileKey(f) + " " + to_string(n) + "\n";
+		count += n;
+		funcs.push_back(inst);
+	}
+	if (funcs.empty())
+	{
+		return;
+	}
+
+	ArrayType* array_type = ArrayType::get(i64, count);
+	GlobalVariable* counters = new GlobalVariable(*llvm_module, array_type, false, GlobalValue::InternalLinkage,
+		ConstantAggregateZero::get(array_type), "__he_profile_counters");
+
+	IRBuilder<> builder(*llvm_context);
+	auto increment = [&](u32 idx, Value* v) {
+		Value* addr = builder.CreateConstInBoundsGEP2_32(array_type, counters, 0, idx);
+		builder.CreateStore(builder.CreateAdd(builder.CreateLoad(i64, addr), v), addr);
+	};
+	for (auto& inst : funcs)
+	{
+		builder.SetInsertPoint(&*inst.func->getEntryBlock().getFirstInsertionPt());
+		increment(inst.base, ConstantInt::get(i64, 1));
+		for (u32 i = 0; i < inst.branches.size(); i++)
+		{
+			BranchInst* br = inst.branches[i];
+			builder.SetInsertPoint(br);
+			increment(inst.base + 1 + 2 * i, ConstantInt::get(i64, 1));
+			increment(inst.base + 2 + 2 * i, builder.CreateZExt(br->getCondition(), i64));
+		}
+	}
+
+	Type* i8_ptr = Type::getInt8PtrTy(*llvm_context);
+	FunctionType* register_type = FunctionType::get(Type::getVoidTy(*llvm_context), { i8_ptr, i8_ptr }, false);
+	FunctionCallee register_func = llvm_module->getOrInsertFunction("__he_profile_register", register_type);
+
+	Function* init = Function::Create(FunctionType::get(Type::getVoidTy(*llvm_context), false),
+		Function::InternalLinkage, "__he_profile_init", *llvm_module);
+	builder.SetInsertPoint(BasicBlock::Create(*llvm_context, "init", init));
+	Value* layout_str = builder.CreateGlobalStringPtr(layout, "__he_profile_layout");
+	builder.CreateCall(register_func, { layout_str, builder.CreateBitCast(counters, i8_ptr) });
+	builder.CreateRetVoid();
+
+	appendToGlobalCtors(*llvm_module, init, 0);
+}
+
+void LLVMCodeGenContext::ApplyProfile()
+{
+	//the summary covers the whole program so every module agrees on what is hot
+	InstrProfSummaryBuilder summary(ProfileSummaryBuilder::DefaultCutoffs);
+	for (auto& [key, counters] : profile->counters)
+	{
+		InstrProfRecord record;
+		record.Counts.push_back(counters.empty() ? 0 : counters[0]);
+		for (u32 i = 1; i + 1 < counters.size(); i += 2)
+		{
+			record.Counts.push_back(counters[i]);
+		}
+		summary.addRecord(record);
+	}
+	llvm_module->setProfileSummary(summary.getSummary()->getMD(*llvm_context), ProfileSummary::PSK_Instr);
+
+	MDBuilder md(*llvm_context);
+	for (auto& f : *llvm_module)
+	{
+		if (f.isDeclaration()) continue;
+		auto v = profile->counters.find(ProfileKey(f));
+		//functions the profiled program didn't contain keep the static estimates
+		if (v == profile->counters.end())
+		{
+			continue;
+		}
+		vector<u64>& counters = v->second;
+		vector<BranchInst*> branches = ConditionalBranches(f);
+		if (counters.size() != 1 + 2 * branches.size())
+		{
+			log += "helang: warning: profile of " + f.getName().str() + " doesn't match its code and is ignored\n";
+			continue;
+		}
+		f.setEntryCount(counters[0]);
+		for (u32 i = 0; i < branches.size(); i++)
+		{
+			u64 executed = counters[1 + 2 * i], taken = min(counters[2 + 2 * i], executed);
+			//branch weights are 32 bit,only their ratio matters
+			u64 scale = executed / UINT32_MAX + 1;
+			branches[i]->setMetadata(LLVMContext::MD_prof,
+				md.createBranchWeights(taken / scale, (executed - taken) / scale));
+		}
+	}
+}
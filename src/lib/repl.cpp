@@ -0,0 +1,362 @@
+#include "repl.h"
+#include "io.h"
+#include "llvm/Support/Process.h"
+#include <iostream>
+
+using namespace llvm;
+
+unique_ptr<ReplSession> ReplSession::Create(Config& config, string& error)
+{
+	unique_ptr<ReplSession> session(new ReplSession(config));
+	auto jit = CreateJIT(config, false);
+	if (!jit)
+	{
+		error = "fail to create jit : " + toString(jit.takeError());
+		return nullptr;
+	}
+	session->jit = std::move(*jit);
+	auto builder = orc::createLocalIndirectStubsManagerBuilder(session->jit->getTargetTriple());
+	if (!builder)
+	{
+		error = "the jit doesn't support stubs on " + session->jit->getTargetTriple().str();
+		return nullptr;
+	}
+	session->stubs = builder();
+	return session;
+}
+
+ReplSession::~ReplSession()
+{
+	if (jit != nullptr)
+	{
+		consumeError(jit->deinitialize(jit->getMainJITDylib()));
+	}
+}
+
+//a function may be redefined with the same signature only,the callers compiled before would
+//pass the wrong arguments otherwise
+bool ReplSession::CheckSignatures(AST& ast, string& error)
+{
+	vector<ptr<SignatureExpr>> defined, declared;
+	ast.Signatures(defined, declared);
+	auto check = [&](ptr<SignatureExpr>& sig, bool define) {
+		auto v = symbols.find(sig->LinkName());
+		if (v == symbols.end())
+		{
+			return true;
+		}
+		SignatureExpr& old = *v->second.signature;
+		bool same = old.GetReturnType() == sig->GetReturnType() && old.GetArgs().size() == sig->GetArgs().size();
+		for (u32 i = 0; same && i < old.GetArgs().size(); i++)
+		{
+			same = old.GetArgs()[i].type == sig->GetArgs()[i].type;
+		}
+		if (!same)
+		{
+			error = "function " + sig->GetName() + " is redefined with a different signature";
+			return false;
+		}
+		if (v->second.defined != define)
+		{
+			error = "function " + sig->GetName() + (define ? " is declared as an extern function" : " is already defined");
+			return false;
+		}
+		return true;
+	};
+	for (auto& sig : defined)
+	{
+		if (!check(sig, true)) return false;
+	}
+	for (auto& sig : declared)
+	{
+		if (!check(sig, false)) return false;
+	}
+	return true;
+}
+
+bool ReplSession::Eval(const string& code, string& output, string& error)
+{
+	Lexer lexer;
+	vector<Token> tokens;
+	if (auto v = lexer.Parse(code); v.has_value())
+	{
+		tokens = v.value();
+	}
+	else
+	{
+		error = lexer.ErrorMsg();
+		return false;
+	}
+	if (tokens.empty())
+	{
+		return true;
+	}
+
+	string echo_name = "__he_repl" + to_string(entries.size());
+	ptr<AST> ast(new AST);
+	if (!ast->ParseEntry(tokens, echo_name))
+	{
+		error = ast->ErrorMsg();
+		return false;
+	}
+	return Define(*ast, output, error);
+}
+
+bool ReplSession::Define(AST& ast, string& output, string& error)
+{
+	u32 id = entries.size();
+	entries.push_back(Entry{ nullptr, 0 });
+	string echo_name = "__he_repl" + to_string(id);
+	//every definition of the session is visible to the later entries,so an import is satisfied by
+	//loading the module as an input before the file importing it
+	if (!CheckSignatures(ast, error))
+	{
+		return false;
+	}
+	vector<ptr<SignatureExpr>> defined, declared, imported;
+	ast.Signatures(defined, declared);
+	for (auto& [name, symbol] : symbols)
+	{
+		imported.push_back(symbol.signature);
+	}
+	ast.Import(imported);
+
+	LLVMCodeGenContext context(config);
+	//a clone would keep the body of the definition it was made from after a redefinition
+	context.specialize_limit = 0;
+	context.llvm_module->setModuleIdentifier(echo_name);
+	context.llvm_module->setTargetTriple(jit->getTargetTriple().str());
+	context.llvm_module->setDataLayout(jit->getDataLayout());
+	bool generated = context.GenerateCode(&ast);
+	output += context.log;
+	if (!generated)
+	{
+		error = ast.ErrorMsg();
+		return false;
+	}
+
+	//a definition is compiled under a name of its own and every call to it,including the ones
+	//in this entry,goes through the stub which keeps the name
+	Module& module = *context.llvm_module;
+	string suffix = ".r" + to_string(id);
+	vector<string> names;
+	for (auto& sig : defined)
+	{
+		string name = sig->LinkName();
+		Function* def = module.getFunction(name);
+		he_assert(def != nullptr);
+		def->setName(name + suffix);
+		Function* decl = Function::Create(def->getFunctionType(), Function::ExternalLinkage, name, module);
+		def->replaceAllUsesWith(decl);
+		names.push_back(name);
+	}
+
+	//the stubs of new functions are defined first,the functions of this entry may call each other
+	orc::JITDylib& main = jit->getMainJITDylib();
+	orc::MangleAndInterner mangle(jit->getExecutionSession(), jit->getDataLayout());
+	for (auto& name : names)
+	{
+		if (stubs->findStub(name, false))
+		{
+			continue;
+		}
+		if (Error e = stubs->createStub(name, 0, JITSymbolFlags::Exported))
+		{
+			error = toString(std::move(e));
+			return false;
+		}
+		orc::SymbolMap stub;
+		stub[mangle(name)] = JITEvaluatedSymbol(stubs->findStub(name, false).getAddress(),
+			JITSymbolFlags::Exported | JITSymbolFlags::Callable);
+		if (Error e = main.define(orc::absoluteSymbols(std::move(stub))))
+		{
+			error = toString(std::move(e));
+			return false;
+		}
+	}
+
+	orc::ResourceTrackerSP tracker = main.createResourceTracker();
+	auto fail = [&](Error e) {
+		error = toString(std::move(e));
+		consumeError(tracker->remove());
+		return false;
+	};
+	orc::ThreadSafeModule tsm(std::move(context.llvm_module), std::move(context.llvm_context));
+	if (Error e = jit->addIRModule(tracker, std::move(tsm)))
+	{
+		return fail(std::move(e));
+	}
+	//module constructors,e.g. the multiversion resolvers
+	if (Error e = jit->initialize(main))
+	{
+		return fail(std::move(e));
+	}
+	vector<JITTargetAddress> addresses;
+	for (auto& name : names)
+	{
+		auto sym = jit->lookup(name + suffix);
+		if (!sym)
+		{
+			return fail(sym.takeError());
+		}
+		addresses.push_back(sym->getAddress());
+	}
+
+	entries[id].tracker = tracker;
+	for (u32 i = 0; i < names.size(); i++)
+	{
+		cantFail(stubs->updatePointer(names[i], addresses[i]));
+		auto v = symbols.find(names[i]);
+		if (v != symbols.end())
+		{
+			//nothing calls the old definition directly,its module goes with its last function
+			Entry& old = entries[v->second.entry];
+			if (--old.live == 0 && !keep_replaced)
+			{
+				consumeError(old.tracker->remove());
+				old.tracker = nullptr;
+			}
+		}
+		entries[id].live++;
+		symbols[names[i]] = Symbol{ defined[i], true, id };
+	}
+	for (auto& sig : declared)
+	{
+		symbols.emplace(sig->LinkName(), Symbol{ sig, false, id });
+	}
+
+	if (context.echo_type.empty())
+	{
+		return true;
+	}
+	auto sym = jit->lookup(echo_name);
+	if (!sym)
+	{
+		return fail(sym.takeError());
+	}
+	u64 value = jitTargetAddressToFunction<u64(*)()>(sym->getAddress())();
+	flush();
+	if (context.echo_type == "i32")
+	{
+		output += to_string((i32)(u32)value) + " : i32\n";
+	}
+	else if (context.echo_type != "void")
+	{
+		output += to_string(value) + " : " + context.echo_type + "\n";
+	}
+	consumeError(tracker->remove());
+	entries[id].tracker = nullptr;
+	return true;
+}
+
+JITTargetAddress ReplSession::Lookup(const string& name)
+{
+	auto sym = jit->lookup(name);
+	if (!sym)
+	{
+		consumeError(sym.takeError());
+		return 0;
+	}
+	return sym->getAddress();
+}
+
+bool ReplSession::IsIncomplete(const string& code)
+{
+	Lexer lexer;
+	auto tokens = lexer.Parse(code);
+	//a lexer error is reported once the entry is evaluated
+	if (!tokens.has_value() || tokens->empty())
+	{
+		return false;
+	}
+	i32 depth = 0;
+	bool body = false;
+	for (auto& t : tokens.value())
+	{
+		if (t.type == HE_TOKEN_LPARENTHESE || t.type == HE_TOKEN_LCURLY) depth++;
+		if (t.type == HE_TOKEN_RPARENTHESE || t.type == HE_TOKEN_RCURLY) depth--;
+		body |= t.type == HE_TOKEN_LCURLY;
+	}
+	if (depth > 0)
+	{
+		return true;
+	}
+	//a signature waits for its body,an extern declaration or an import for its semicolon
+	HE_TOKEN_TYPE first = tokens->front().type;
+	if (first == HE_TOKEN_FUNC || first == HE_TOKEN_MULTIVERSION)
+	{
+		return !body;
+	}
+	if (first == HE_TOKEN_EXTERN || first == HE_TOKEN_IMPORT)
+	{
+		return tokens->back().type != HE_TOKEN_SEMICOLON;
+	}
+	return false;
+}
+
+int RunRepl(Config& config, const vector<string>& inputs)
+{
+	string error;
+	unique_ptr<ReplSession> session = ReplSession::Create(config, error);
+	if (session == nullptr)
+	{
+		printf("helang: %s\n", error.c_str());
+		return -1;
+	}
+	auto eval = [&](const string& code) {
+		string output;
+		bool res = session->Eval(code, output, error);
+		fputs(output.c_str(), stdout);
+		if (!res)
+		{
+			printf("helang: %s\n", error.c_str());
+			error.clear();
+		}
+		fflush(stdout);
+		return res;
+	};
+
+	for (auto& input : inputs)
+	{
+		if (auto v = IO::Get().LoadFile(input); !v.has_value())
+		{
+			printf("helang: fail to load file %s\n", input.c_str());
+			return -1;
+		}
+		else if (!eval(v.value()))
+		{
+			return -1;
+		}
+	}
+
+	bool prompt = sys::Process::StandardInIsUserInput();
+	string entry, line;
+	while (true)
+	{
+		if (prompt)
+		{
+			fputs(entry.empty() ? "he> " : "..> ", stdout);
+			fflush(stdout);
+		}
+		if (!getline(cin, line))
+		{
+			break;
+		}
+		if (entry.empty() && (line == ":q" || line == ":quit"))
+		{
+			return 0;
+		}
+		entry += line + "\n";
+		if (!ReplSession::IsIncomplete(entry))
+		{
+			eval(entry);
+			entry.clear();
+		}
+	}
+	//an unfinished entry at the end of the input reports its error
+	if (!entry.empty())
+	{
+		eval(entry);
+	}
+	return 0;
+}
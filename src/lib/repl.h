@@ -0,0 +1,56 @@
+#pragma once
+#include "jit.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include <map>
+
+//an interactive session on one jit,every entry is compiled to a module of its own
+//functions defined in the session are called through stubs,redefining a function points its
+//stub to the new code so the functions compiled before call the new definition
+class ReplSession
+{
+public:
+	static unique_ptr<ReplSession> Create(Config& config, string& error);
+	~ReplSession();
+
+	//compile an entry and run it if it is made of statements,the value of its last expression
+	//and the diagnostics are appended to output
+	bool Eval(const string& code, string& output, string& error);
+	//compile the functions of ast into the session,the stubs of the ones defined before are
+	//pointed to the new code,an echo function in ast is run
+	bool Define(AST& ast, string& output, string& error);
+	//address of a function of the session,0 if it isn't defined
+	llvm::JITTargetAddress Lookup(const string& name);
+	//keep the code of replaced definitions,another thread may still be running it
+	void KeepReplaced() { keep_replaced = true; }
+	//whether the entry continues on the next line,e.g. a function body isn't closed yet
+	static bool IsIncomplete(const string& code);
+
+private:
+	ReplSession(Config& config) :config(config) {}
+
+	struct Symbol
+	{
+		ptr<SignatureExpr> signature;
+		bool               defined;
+		//entry holding the current definition
+		u32                entry;
+	};
+	//the module of an entry is dropped once none of its functions is current
+	struct Entry
+	{
+		llvm::orc::ResourceTrackerSP tracker;
+		u32 live;
+	};
+
+	bool CheckSignatures(AST& ast, string& error);
+
+	Config& config;
+	unique_ptr<llvm::orc::LLJIT> jit;
+	unique_ptr<llvm::orc::IndirectStubsManager> stubs;
+	map<string, Symbol> symbols;
+	vector<Entry> entries;
+	bool keep_replaced = false;
+};
+
+//read entries from stdin until it ends or :q is entered,the inputs are loaded first
+int RunRepl(Config& config, const vector<string>& inputs);
@@ -0,0 +1,103 @@
+#include "runtime.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include <fstream>
+#include <set>
+
+//runtime functions of up to this many instructions are inlined,the wrappers of printf and scanf
+//such as print_i32 are a handful
+static const u32 inline_limit = 32;
+
+ptr<string> LoadRuntime(const string& path) {
+	ifstream in(path, ios::binary);
+	if (!in) {
+		return nullptr;
+	}
+	return make_shared<string>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+bool LinkRuntime(llvm::Module& module, const string& bitcode, string& log) {
+	auto runtime = llvm::getLazyBitcodeModule(llvm::MemoryBufferRef(bitcode, "helang_rt.bc"), module.getContext());
+	if (!runtime) {
+		log += "helang: invalid runtime bitcode," + llvm::toString(runtime.takeError()) + "\n";
+		return false;
+	}
+	//the runtime is compiled for the host,its functions take the target of the module
+	(*runtime)->setTargetTriple(module.getTargetTriple());
+	(*runtime)->setDataLayout(module.getDataLayout());
+
+	//the linker replaces the declarations the runtime defines,the definitions stay
+	set<llvm::GlobalValue*> own;
+	for (auto& g : module.global_values()) {
+		if (!g.isDeclaration()) own.insert(&g);
+	}
+	//only the functions the module calls and what they use are materialized
+	if (llvm::Linker::linkModules(module, std::move(runtime.get()), llvm::Linker::LinkOnlyNeeded)) {
+		log += "helang: fail to link the runtime bitcode\n";
+		return false;
+	}
+
+	bool supports_comdat = llvm::Triple(module.getTargetTriple()).supportsCOMDAT();
+	//in module order so the output doesn't depend on addresses
+	vector<llvm::GlobalValue*> linked;
+	for (auto& g : module.global_values()) {
+		if (own.count(&g) || g.isDeclaration()) continue;
+		linked.push_back(&g);
+		if (g.hasExternalLinkage()) {
+			g.setLinkage(llvm::GlobalValue::LinkOnceODRLinkage);
+		}
+		//a static of a runtime function,e.g. the keyboard of powerCon,is shared by the copies
+		//inlined into every module like a static of a c++ inline function
+		if (auto v = llvm::dyn_cast<llvm::GlobalVariable>(&g); v != nullptr && !v->isConstant() && v->hasLocalLinkage()) {
+			v->setLinkage(llvm::GlobalValue::LinkOnceODRLinkage);
+			v->setVisibility(llvm::GlobalValue::HiddenVisibility);
+		}
+		//without a comdat the linker keeps every copy and only resolves the symbol to one
+		if (auto object = llvm::dyn_cast<llvm::GlobalObject>(&g); object != nullptr && object->hasLinkOnceODRLinkage() && supports_comdat) {
+			object->setComdat(module.getOrInsertComdat(object->getName()));
+		}
+		if (auto f = llvm::dyn_cast<llvm::Function>(&g)) {
+			//RecordTarget gives them the cpu of the module
+			f->removeFnAttr("target-cpu");
+			f->removeFnAttr("target-features");
+			f->removeFnAttr("tune-cpu");
+		}
+	}
+
+	for (auto g : linked) {
+		auto f = llvm::dyn_cast<llvm::Function>(g);
+		if (f == nullptr || f->getInstructionCount() > inline_limit) continue;
+		vector<llvm::CallBase*> calls;
+		for (auto user : f->users()) {
+			auto call = llvm::dyn_cast<llvm::CallBase>(user);
+			//a guaranteed tail call stays a call
+			if (call != nullptr && call->getCalledFunction() == f && !call->isMustTailCall() &&
+				own.count(call->getFunction())) {
+				calls.push_back(call);
+			}
+		}
+		for (auto call : calls) {
+			llvm::InlineFunctionInfo info;
+			llvm::InlineFunction(*call, info);
+		}
+	}
+
+	//what is no longer called,also through other runtime functions,is dropped
+	for (bool erased = true; erased;) {
+		erased = false;
+		for (auto& g : linked) {
+			if (g == nullptr) continue;
+			g->removeDeadConstantUsers();
+			if (g->use_empty()) {
+				g->eraseFromParent();
+				g = nullptr;
+				erased = true;
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "common.h"
+
+namespace llvm {
+	class Module;
+}
+
+//the runtime of template/io.c and template/cpu.c compiled to bitcode at build time,helang_rt.bc
+//next to helang-c,main.c stays in libhelang_rt.a
+//returns nullptr if the file can't be read
+ptr<string> LoadRuntime(const string& path);
+
+//link the runtime functions the module calls into it,small ones are inlined into their callers
+//and the ones left are linkonce_odr so the executable keeps a single copy
+//the archive still provides them to modules compiled without the bitcode
+bool LinkRuntime(llvm::Module& module, const string& bitcode, string& log);
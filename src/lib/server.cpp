@@ -0,0 +1,196 @@
+#include "server.h"
+#include "helang.h"
+#include "jit.h"
+#include <map>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+int RunServer(const string& socket_path, const function<int(int, const char**)>& drive) {
+	printf("helang: --server isn't supported on this platform\n");
+	return -1;
+}
+
+#else
+
+static optional<vector<string>> ReadRequest(int fd) {
+	u32 count;
+	if (!ReadAll(fd, &count, sizeof(count)) || count < 2 || count > 4096) {
+		return {};
+	}
+	vector<string> request(count);
+	for (auto& s : request) {
+		u32 size;
+		if (!ReadAll(fd, &size, sizeof(size)) || size > (1u << 20)) {
+			return {};
+		}
+		s.resize(size);
+		if (!ReadAll(fd, s.data(), size)) {
+			return {};
+		}
+	}
+	return request;
+}
+
+//runs in the forked child,the connection becomes stdout and stderr
+[[noreturn]] static void Serve(int fd, const function<int(int, const char**)>& drive) {
+	optional<vector<string>> request = ReadRequest(fd);
+	if (!request.has_value()) {
+		_exit(-1);
+	}
+	int null = open("/dev/null", O_RDONLY);
+	dup2(null, STDIN_FILENO);
+	dup2(fd, STDOUT_FILENO);
+	dup2(fd, STDERR_FILENO);
+	close(null);
+	close(fd);
+	setvbuf(stdout, nullptr, _IOLBF, 0);
+	if (chdir(request->front().c_str()) != 0) {
+		printf("helang: fail to change the directory to %s\n", request->front().c_str());
+		fflush(stdout);
+		_exit(-1);
+	}
+	vector<const char*> argvs;
+	for (u32 i = 1; i < request->size(); i++) {
+		argvs.push_back((*request)[i].c_str());
+	}
+	argvs.push_back(nullptr);
+	int rtv = drive(argvs.size() - 1, argvs.data());
+	//_exit skips atexit,the runtime buffer is written here
+	flush();
+	_exit(rtv);
+}
+
+//written by the signal handlers,the loop wakes up on any byte
+static int g_wake[2] = { -1, -1 };
+static volatile sig_atomic_t g_stop = 0;
+
+static void OnChild(int) {
+	int e = errno;
+	(void)!write(g_wake[1], "c", 1);
+	errno = e;
+}
+
+static void OnStop(int) {
+	g_stop = 1;
+	(void)!write(g_wake[1], "s", 1);
+}
+
+//the compiler pages and the lazily created llvm state are copied to every child,so they are
+//loaded once here
+static void Warm() {
+	helang::Session session;
+	session.CompileObject("warm.he", "fn main() -> i32 {\n    0\n}\n");
+}
+
+int RunServer(const string& socket_path, const function<int(int, const char**)>& drive) {
+	auto addr = SocketAddress(socket_path);
+	if (!addr.has_value()) {
+		printf("helang: socket path %s is too long\n", socket_path.c_str());
+		return -1;
+	}
+	if (string error; !PrepareSocketDirectory(socket_path, error)) {
+		printf("helang: %s\n", error.c_str());
+		return -1;
+	}
+	//a socket left by a server which is gone is replaced
+	if (int fd = ConnectSocket(socket_path); fd >= 0) {
+		close(fd);
+		printf("helang: a server is already listening on %s\n", socket_path.c_str());
+		return -1;
+	}
+	unlink(socket_path.c_str());
+
+	int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listener < 0 || bind(listener, (sockaddr*)&addr.value(), sizeof(sockaddr_un)) != 0 || listen(listener, 64) != 0) {
+		printf("helang: fail to listen on %s : %s\n", socket_path.c_str(), strerror(errno));
+		return -1;
+	}
+	if (pipe2(g_wake, O_CLOEXEC | O_NONBLOCK) != 0) {
+		printf("helang: %s\n", strerror(errno));
+		return -1;
+	}
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGCHLD, OnChild);
+	signal(SIGINT, OnStop);
+	signal(SIGTERM, OnStop);
+
+	Warm();
+	printf("helang: listening on %s\n", socket_path.c_str());
+	fflush(stdout);
+
+	//connection of every running child,the exit code is sent once the child is done
+	map<pid_t, int> children;
+	while (!g_stop) {
+		pollfd fds[2] = { { listener, POLLIN, 0 }, { g_wake[0], POLLIN, 0 } };
+		if (poll(fds, 2, -1) < 0) {
+			continue;
+		}
+		if (fds[1].revents & POLLIN) {
+			char drain[64];
+			while (read(g_wake[0], drain, sizeof(drain)) > 0) {}
+			int status;
+			pid_t pid;
+			while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+				auto v = children.find(pid);
+				if (v == children.end()) continue;
+				i32 rtv;
+				if (WIFEXITED(status)) {
+					rtv = (i8)WEXITSTATUS(status);
+				}
+				else {
+					string msg = "helang: the compiler crashed with signal " + to_string(WTERMSIG(status)) + "\n";
+					WriteAll(v->second, msg.data(), msg.size());
+					rtv = 128 + WTERMSIG(status);
+				}
+				WriteAll(v->second, &rtv, sizeof(rtv));
+				close(v->second);
+				children.erase(v);
+			}
+		}
+		if (fds[0].revents & POLLIN) {
+			int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+			if (fd < 0) {
+				continue;
+			}
+			//requests of other users aren't run with the rights of this one
+			if (!PeerIsUser(fd)) {
+				close(fd);
+				continue;
+			}
+			pid_t pid = fork();
+			if (pid == 0) {
+				//the connections of the other requests end when their own child exits
+				for (auto& [p, c] : children) close(c);
+				close(listener);
+				close(g_wake[0]);
+				close(g_wake[1]);
+				signal(SIGPIPE, SIG_DFL);
+				signal(SIGCHLD, SIG_DFL);
+				signal(SIGINT, SIG_DFL);
+				signal(SIGTERM, SIG_DFL);
+				Serve(fd, drive);
+			}
+			if (pid < 0) {
+				i32 rtv = -1;
+				WriteAll(fd, &rtv, sizeof(rtv));
+				close(fd);
+				continue;
+			}
+			children[pid] = fd;
+		}
+	}
+	close(listener);
+	unlink(socket_path.c_str());
+	return 0;
+}
+
+#endif
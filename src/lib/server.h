@@ -0,0 +1,33 @@
+#pragma once
+#include "common.h"
+#include <functional>
+#ifndef _WIN32
+#include <sys/un.h>
+#endif
+
+//persistent compile server,helang-c --server keeps llvm loaded and initialized and forks a child
+//for every request,so a compile doesn't pay for starting the compiler,requests run concurrently
+//helang-client forwards its cwd and arguments to the server and streams the output back
+//posix only,helang-client runs helang-c itself elsewhere
+
+//$HELANG_SOCKET,helang.sock in $XDG_RUNTIME_DIR or in helang-<uid> of the temp directory,which
+//the server creates with mode 0700
+string DefaultSocketPath();
+//serve until SIGINT or SIGTERM,drive runs a request in the child after changing to its cwd
+int RunServer(const string& socket_path, const function<int(int, const char**)>& drive);
+//send the arguments to the server and return its exit code,nothing if no server is listening
+optional<int> RunClient(const string& socket_path, const vector<string>& args);
+
+#ifndef _WIN32
+//socket helpers shared by the client and the server
+bool WriteAll(int fd, const void* data, usize size);
+bool ReadAll(int fd, void* data, usize size);
+optional<sockaddr_un> SocketAddress(const string& path);
+//connected socket,-1 if nothing listens on path
+int ConnectSocket(const string& path);
+//whether the other end of a connected socket runs as this user
+bool PeerIsUser(int fd);
+//create the directory of the socket with mode 0700,returns false with error set if it exists and
+//isn't a directory of this user with mode 0700
+bool PrepareSocketDirectory(const string& socket_path, string& error);
+#endif
@@ -0,0 +1,182 @@
+#include "helang.h"
+#include "compiler.h"
+#include "jit.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include <mutex>
+
+using namespace llvm;
+
+namespace helang {
+
+	static std::once_flag g_target_initialized;
+
+	Session::Session(const Options& options) :config(new Config())
+	{
+		std::call_once(g_target_initialized, []() {
+			InitializeNativeTarget();
+			InitializeNativeTargetAsmPrinter();
+			InitializeNativeTargetAsmParser();
+		});
+		config->cpu = options.cpu;
+		config->features = options.features;
+		config->specialize_limit = options.specialize_limit;
+		config->warn_tail = options.warn_tail;
+		config->multiversion = options.multiversion;
+		config->multiversion_levels = options.multiversion_levels;
+		config->split = 1;
+		config->stream = 0;
+		//a session does no disk i/o
+		config->interfaces = false;
+		config->emit = "obj";
+		config->engine = "jit";
+		config->tier_threshold = 1000;
+		ResolveTargetCPU(*config);
+	}
+
+	Session::~Session() = default;
+
+	//every session creates one target machine and reuses it for all the sources it compiles
+	TargetMachine* Session::Target()
+	{
+		if (target_machine == nullptr)
+		{
+			string error;
+			target_machine = CreateTargetMachine(*config, error);
+			if (target_machine == nullptr)
+			{
+				log += "helang: " + error + "\n";
+			}
+		}
+		return target_machine.get();
+	}
+
+	optional<vector<char>> Session::CompileObject(const string& name, const string& source)
+	{
+		log.clear();
+		TargetMachine* target = Target();
+		if (target == nullptr)
+		{
+			return {};
+		}
+		ptr<LLVMCodeGenContext> context = GenerateModule(name, source, *config, target, log);
+		if (context == nullptr)
+		{
+			return {};
+		}
+		SmallVector<char, 0> buffer;
+		raw_svector_ostream dest(buffer);
+		if (!EmitObject(*context->llvm_module, target, dest, log))
+		{
+			return {};
+		}
+		return vector<char>(buffer.begin(), buffer.end());
+	}
+
+	optional<orc::ThreadSafeModule> Session::CompileModule(const string& name, const string& source)
+	{
+		log.clear();
+		TargetMachine* target = Target();
+		if (target == nullptr)
+		{
+			return {};
+		}
+		ptr<LLVMCodeGenContext> context = GenerateModule(name, source, *config, target, log);
+		if (context == nullptr)
+		{
+			return {};
+		}
+		return orc::ThreadSafeModule(std::move(context->llvm_module), std::move(context->llvm_context));
+	}
+
+	ptr<Program> Session::CompileProgram(const vector<pair<string, string>>& sources)
+	{
+		log.clear();
+		TargetMachine* target = Target();
+		if (target == nullptr)
+		{
+			return nullptr;
+		}
+		auto jit = CreateJIT(*config, false);
+		if (!jit)
+		{
+			log += "helang: fail to create jit : " + toString(jit.takeError()) + "\n";
+			return nullptr;
+		}
+		for (auto& [name, source] : sources)
+		{
+			ptr<LLVMCodeGenContext> context = GenerateModule(name, source, *config, target, log);
+			if (context == nullptr)
+			{
+				return nullptr;
+			}
+			context->llvm_module->setDataLayout((*jit)->getDataLayout());
+			orc::ThreadSafeModule tsm(std::move(context->llvm_module), std::move(context->llvm_context));
+			if (Error e = (*jit)->addIRModule(std::move(tsm)))
+			{
+				log += "helang: " + toString(std::move(e)) + "\n";
+				return nullptr;
+			}
+		}
+		ptr<Program> program(new Program());
+		program->jit = std::move(*jit);
+		return program;
+	}
+
+	Program::~Program()
+	{
+		if (jit != nullptr && initialized)
+		{
+			consumeError(jit->deinitialize(jit->getMainJITDylib()));
+		}
+	}
+
+	//module constructors,e.g. the multiversion resolvers
+	bool Program::Initialize(string& error)
+	{
+		if (initialized)
+		{
+			return true;
+		}
+		if (Error e = jit->initialize(jit->getMainJITDylib()))
+		{
+			error = toString(std::move(e));
+			return false;
+		}
+		initialized = true;
+		return true;
+	}
+
+	void* Program::Lookup(const string& name)
+	{
+		string error;
+		if (!Initialize(error))
+		{
+			return nullptr;
+		}
+		auto sym = jit->lookup(name);
+		if (!sym)
+		{
+			consumeError(sym.takeError());
+			return nullptr;
+		}
+		return jitTargetAddressToPointer<void*>(sym->getAddress());
+	}
+
+	optional<int> Program::Run(string& error)
+	{
+		if (!Initialize(error))
+		{
+			return {};
+		}
+		auto entry = jit->lookup("__he_entry_main");
+		if (!entry)
+		{
+			error = toString(entry.takeError());
+			return {};
+		}
+		int rtv = jitTargetAddressToFunction<int (*)()>(entry->getAddress())();
+		flush();
+		return rtv;
+	}
+}
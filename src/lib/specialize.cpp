@@ -0,0 +1,260 @@
+#include "ast.h"
+#include <map>
+#include <set>
+
+//call-site specialization
+//a call passing literal arguments to a function defined in the same file is redirected
+//to a clone of the callee,the bound arguments become constant ssa values in the clone so
+//the ir builder folds the arithmetic on them and IfExpr prunes branches on folded conditions
+//a clone has fewer arguments than its callee,so the guaranteed tail calls of tailcall.cpp are kept
+//by leaving alone the calls and the functions that would lose them
+
+void CalculateExpr::CollectCalls(vector<CallExpr*>& calls)
+{
+	lhs->CollectCalls(calls);
+	rhs->CollectCalls(calls);
+}
+
+void CallExpr::CollectCalls(vector<CallExpr*>& calls)
+{
+	for (auto& arg : args)
+	{
+		arg->CollectCalls(calls);
+	}
+	calls.push_back(this);
+}
+
+void AssignExpr::CollectCalls(vector<CallExpr*>& calls)
+{
+	expr->CollectCalls(calls);
+}
+
+void DeclearExpr::CollectCalls(vector<CallExpr*>& calls)
+{
+	if (assign != nullptr)
+	{
+		assign->CollectCalls(calls);
+	}
+}
+
+void BodyExpr::CollectCalls(vector<CallExpr*>& calls)
+{
+	for (auto& expr : body)
+	{
+		if (expr != nullptr) expr->CollectCalls(calls);
+	}
+	if (rt_expr != nullptr)
+	{
+		rt_expr->CollectCalls(calls);
+	}
+}
+
+void IfExpr::CollectCalls(vector<CallExpr*>& calls)
+{
+	cond->CollectCalls(calls);
+	then_expr->CollectCalls(calls);
+	for (u32 i = 0; i < elif_expr.size(); i++)
+	{
+		elif_cond_expr[i]->CollectCalls(calls);
+		elif_expr[i]->CollectCalls(calls);
+	}
+	if (else_expr != nullptr)
+	{
+		else_expr->CollectCalls(calls);
+	}
+}
+
+void FuncExpr::CollectCalls(vector<CallExpr*>& calls)
+{
+	body->CollectCalls(calls);
+}
+
+ptr<SignatureExpr> SignatureExpr::Clone(const string& name, const vector<Declearation>& args)
+{
+	ptr<SignatureExpr> sig(new SignatureExpr(*this));
+	sig->name = name;
+	sig->args = args;
+	return sig;
+}
+
+ptr<FuncExpr> FuncExpr::Specialize(const string& name, const vector<optional<string>>& binding)
+{
+	const vector<Declearation>& params = signature->GetArgs();
+	he_assert(params.size() == binding.size());
+
+	vector<Declearation> remaining;
+	ptr<FuncExpr> func(new FuncExpr(*this));
+	for (u32 i = 0; i < params.size(); i++)
+	{
+		if (binding[i].has_value())
+		{
+			func->constant_args.push_back({ params[i].name, binding[i].value() });
+		}
+		else
+		{
+			remaining.push_back(params[i]);
+		}
+	}
+	func->signature = signature->Clone(name, remaining);
+	return func;
+}
+
+//only i32 arguments are bound,NumberExpr always produces an i32 so binding a literal to
+//another type would hide the type mismatch the original call reports
+static optional<string> LiteralBinding(ptr<Expr>& arg, const Declearation& param)
+{
+	NumberExpr* num = dynamic_cast<NumberExpr*>(arg.get());
+	if (num == nullptr || param.type != "i32")
+	{
+		return {};
+	}
+	try
+	{
+		stoi(num->GetNumber());
+	}
+	catch (...)
+	{
+		//leave the literal to NumberExpr so the error is reported at the call site
+		return {};
+	}
+	return num->GetNumber();
+}
+
+//the argument and return types,a call is a guaranteed tail call if the callee has the caller's
+static string TypeKey(const vector<Declearation>& args, const string& return_type)
+{
+	string key = return_type + "(";
+	for (auto& a : args)
+	{
+		key += a.type + ",";
+	}
+	return key + ")";
+}
+
+void TopLevelExpr::Specialize(u32 limit, string* report)
+{
+	map<string, ptr<FuncExpr>> defined;
+	map<string, string> types;
+	for (auto& s : extern_funcs)
+	{
+		types[s->GetName()] = TypeKey(s->GetArgs(), s->GetReturnType());
+	}
+	for (auto& f : funcs)
+	{
+		defined[f->GetSignature()->GetName()] = f;
+		types[f->GetSignature()->GetName()] = TypeKey(f->GetSignature()->GetArgs(), f->GetSignature()->GetReturnType());
+	}
+
+	//the calls of a clone body are the ones of its callee,a guaranteed tail call in it would
+	//become a plain call in the clone,e.g. a self call that goes to the callee from the clone
+	map<FuncExpr*, set<CallExpr*>> tail_calls;
+	set<string> keeps_tail_calls;
+	for (auto& f : funcs)
+	{
+		vector<CallExpr*> calls;
+		f->CollectTailCalls(calls);
+		const string& name = f->GetSignature()->GetName();
+		for (CallExpr* call : calls)
+		{
+			tail_calls[f.get()].insert(call);
+			if (auto v = types.find(call->GetFunc()); v != types.end() && v->second == types[name])
+			{
+				keeps_tail_calls.insert(name);
+			}
+		}
+	}
+
+	struct Clone
+	{
+		string name, callee, binding;
+		u32    call_sites;
+	};
+	vector<Clone> clones;
+	map<string, u32> clone_index;
+	map<string, u32> clone_count;
+	vector<ptr<FuncExpr>> created;
+
+	for (auto& f : funcs)
+	{
+		vector<CallExpr*> calls;
+		f->CollectCalls(calls);
+		for (CallExpr* call : calls)
+		{
+			auto callee = defined.find(call->GetFunc());
+			if (callee == defined.end() || keeps_tail_calls.count(callee->first))
+			{
+				continue;
+			}
+			const vector<Declearation>& params = callee->second->GetSignature()->GetArgs();
+			vector<ptr<Expr>> args = call->GetArgs();
+			//arity mismatch is reported by CallExpr::CodeGenerate
+			if (params.size() != args.size())
+			{
+				continue;
+			}
+
+			vector<optional<string>> binding;
+			vector<ptr<Expr>> remaining;
+			vector<Declearation> remaining_params;
+			string key;
+			for (u32 i = 0; i < params.size(); i++)
+			{
+				binding.push_back(LiteralBinding(args[i], params[i]));
+				if (i != 0) key += ",";
+				if (binding.back().has_value())
+				{
+					key += binding.back().value();
+				}
+				else
+				{
+					key += "_";
+					remaining.push_back(args[i]);
+					remaining_params.push_back(params[i]);
+				}
+			}
+			if (remaining.size() == args.size())
+			{
+				continue;
+			}
+			//a tail call is only redirected to a clone with the signature of the caller
+			if (tail_calls[f.get()].count(call) &&
+				TypeKey(remaining_params, callee->second->GetSignature()->GetReturnType()) != types[f->GetSignature()->GetName()])
+			{
+				continue;
+			}
+
+			u32 idx;
+			if (auto v = clone_index.find(callee->first + "(" + key + ")"); v != clone_index.end())
+			{
+				idx = v->second;
+			}
+			else
+			{
+				u32& count = clone_count[callee->first];
+				if (count >= limit)
+				{
+					continue;
+				}
+				string name = callee->first + ".spec" + to_string(count++);
+				created.push_back(callee->second->Specialize(name, binding));
+
+				idx = clones.size();
+				clone_index[callee->first + "(" + key + ")"] = idx;
+				clones.push_back({ name, callee->first, key, 0 });
+			}
+			call->Redirect(clones[idx].name, remaining);
+			clones[idx].call_sites++;
+		}
+	}
+
+	funcs.insert(funcs.end(), created.begin(), created.end());
+
+	if (report != nullptr)
+	{
+		for (auto& c : clones)
+		{
+			*report += "helang: specialized " + c.callee + "(" + c.binding + ") as " + c.name +
+				" for " + to_string(c.call_sites) + " call site(s)\n";
+		}
+	}
+}
@@ -0,0 +1,104 @@
+#include "stream.h"
+#include "ast.h"
+#include "builddb.h"
+#include <algorithm>
+#include <unordered_set>
+
+bool ItemReader::Open(const string& path) {
+	in.open(path, ios::binary);
+	return (bool)in;
+}
+
+optional<vector<Token>> ItemReader::Next(string& error) {
+	vector<Token> item;
+	i32 depth = 0;
+	bool body = false;
+	while (true) {
+		if (pending_pos == pending.size()) {
+			string text;
+			//an item left open at the end of the source is handed to the parser as it is
+			if (!getline(in, text)) {
+				return item;
+			}
+			//the same bytes HashContent of the whole source sees
+			hash = HashContent(text, hash);
+			if (!in.eof()) hash = HashContent("\n", hash);
+			line++;
+			auto v = lexer.ParseLine(text, line);
+			if (!v.has_value()) {
+				error = lexer.ErrorMsg();
+				return {};
+			}
+			pending = std::move(v.value());
+			pending_pos = 0;
+			continue;
+		}
+
+		const Token& t = pending[pending_pos++];
+		item.push_back(t);
+		HE_TOKEN_TYPE first = item.front().type;
+		//a token no item starts with,the parser reports it
+		if (first != HE_TOKEN_FUNC && first != HE_TOKEN_MULTIVERSION && first != HE_TOKEN_EXTERN && first != HE_TOKEN_IMPORT) {
+			return item;
+		}
+		if (t.type == HE_TOKEN_LCURLY) {
+			depth++;
+			body = true;
+		}
+		else if (t.type == HE_TOKEN_RCURLY) {
+			depth--;
+		}
+		//a declaration ends at its semicolon,a function at the curly closing its body
+		bool declaration = first == HE_TOKEN_EXTERN || first == HE_TOKEN_IMPORT;
+		if (declaration ? t.type == HE_TOKEN_SEMICOLON : body && depth <= 0) {
+			return item;
+		}
+	}
+}
+
+optional<SourceSignatures> ScanSignatures(const string& path, string& error) {
+	ItemReader reader;
+	if (!reader.Open(path)) {
+		error = "fail to load file " + path;
+		return {};
+	}
+	SourceSignatures res;
+	unordered_set<string> names;
+	while (true) {
+		auto item = reader.Next(error);
+		if (!item.has_value()) {
+			return {};
+		}
+		if (item->empty()) {
+			break;
+		}
+		//the body of a function is left for the second pass,an empty one takes its place
+		HE_TOKEN_TYPE first = item->front().type;
+		auto lcurly = find_if(item->begin(), item->end(), [](Token& t) { return t.type == HE_TOKEN_LCURLY; });
+		if (first != HE_TOKEN_EXTERN && first != HE_TOKEN_IMPORT && lcurly != item->end()) {
+			Token close = *lcurly;
+			close.type = HE_TOKEN_RCURLY;
+			close.token = "}";
+			item->erase(lcurly + 1, item->end());
+			item->push_back(close);
+		}
+		AST ast;
+		if (!ast.Parse(item.value())) {
+			error = ast.ErrorMsg();
+			return {};
+		}
+		res.imports.insert(res.imports.end(), ast.Imports().begin(), ast.Imports().end());
+		vector<ptr<SignatureExpr>> defined, declared;
+		ast.Signatures(defined, declared);
+		res.declared.insert(res.declared.end(), declared.begin(), declared.end());
+		for (auto& f : ast.Functions()) {
+			if (!names.insert(f->GetSignature()->GetName()).second) {
+				error = "function " + f->GetSignature()->GetName() + " is defined more than once at " + f->Location();
+				return {};
+			}
+			res.funcs.push_back(f);
+		}
+	}
+	res.hash = reader.Hash();
+	return res;
+}
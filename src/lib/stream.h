@@ -0,0 +1,45 @@
+#pragma once
+#include "tokens.h"
+#include <fstream>
+
+class FuncExpr;
+class SignatureExpr;
+
+//streaming compilation of helang-c --stream,a source is read twice one top-level item at a time
+//instead of being held whole,the first pass keeps only the signatures,the second one parses
+//and generates a batch of items at a time so memory follows the largest batch and not the file
+
+//reads a source a line at a time and splits its tokens into top-level items,an item is an
+//import,a ccnd declaration or a function with the multiversion before it
+class ItemReader {
+public:
+	//returns false if the file can't be opened
+	bool Open(const string& path);
+	//tokens of the next item,empty at the end of the source,nothing with error set if a line
+	//can't be lexed
+	optional<vector<Token>> Next(string& error);
+	//HashContent of the lines read so far,the one of the whole source at the end
+	u64 Hash() { return hash; }
+
+private:
+	ifstream in;
+	Lexer lexer;
+	u32 line = 0;
+	u64 hash = 14695981039346656037ull;
+	//tokens of the current line not yet handed out
+	vector<Token> pending;
+	u32 pending_pos = 0;
+};
+
+//what the first pass keeps of a source
+struct SourceSignatures {
+	vector<Token> imports;
+	//the functions defined by the source,their bodies are empty
+	vector<ptr<FuncExpr>> funcs;
+	//ccnd declarations
+	vector<ptr<SignatureExpr>> declared;
+	u64 hash = 0;
+};
+
+//the first pass,a function defined twice is an error
+optional<SourceSignatures> ScanSignatures(const string& path, string& error);
@@ -0,0 +1,74 @@
+#include "ast.h"
+
+//tail call detection
+//a call whose value is returned right away is lowered by CallExpr::CodeGenerate to a branch
+//back to the loop header when it calls the function itself,or to a musttail call when the
+//callee has the same signature as the caller
+
+void BodyExpr::CollectTailCalls(vector<CallExpr*>& calls)
+{
+	if (CallExpr* call = dynamic_cast<CallExpr*>(rt_expr.get()); call != nullptr)
+	{
+		calls.push_back(call);
+		return;
+	}
+
+	//mut i32 r = ...; if (...) { r = f(...); } r
+	VariableExpr* var = dynamic_cast<VariableExpr*>(rt_expr.get());
+	if (var == nullptr || body.empty())
+	{
+		return;
+	}
+	if (IfExpr* expr = dynamic_cast<IfExpr*>(body.back().get()); expr != nullptr)
+	{
+		expr->CollectTailCalls(var->GetName(), calls);
+	}
+}
+
+void BodyExpr::CollectAssignedTailCalls(const string& var, vector<CallExpr*>& calls)
+{
+	//the returned expression of a branch is evaluated after its last statement
+	if (rt_expr != nullptr || body.empty())
+	{
+		return;
+	}
+
+	Expr* last = body.back().get();
+	if (AssignExpr* assign = dynamic_cast<AssignExpr*>(last); assign != nullptr)
+	{
+		if (assign->GetName() != var)
+		{
+			return;
+		}
+		if (CallExpr* call = dynamic_cast<CallExpr*>(assign->GetExpr().get()); call != nullptr)
+		{
+			calls.push_back(call);
+		}
+	}
+	else if (IfExpr* expr = dynamic_cast<IfExpr*>(last); expr != nullptr)
+	{
+		expr->CollectTailCalls(var, calls);
+	}
+}
+
+void IfExpr::CollectTailCalls(const string& var, vector<CallExpr*>& calls)
+{
+	then_expr->CollectAssignedTailCalls(var, calls);
+	for (auto& body : elif_expr)
+	{
+		body->CollectAssignedTailCalls(var, calls);
+	}
+	if (else_expr != nullptr)
+	{
+		else_expr->CollectAssignedTailCalls(var, calls);
+	}
+}
+
+void FuncExpr::CollectTailCalls(vector<CallExpr*>& calls)
+{
+	//the value of an echo function is converted before it is returned
+	if (signature->GetReturnType() != "void" && !echo)
+	{
+		body->CollectTailCalls(calls);
+	}
+}
@@ -1,13 +1,30 @@
 #include "tokens.h"
+#include <cstring>
 #include <unordered_map>
 #include <sstream>
 #include <tuple>
-unique_ptr<Lexer> Lexer::m_lexer;
-static string g_entry;
-unordered_map<string, Token> m_keyword_map;
+//the tables are constant after static initialization,every compile thread reads them
+static const unordered_map<string, Token> g_keyword_map = {
+	{"fn", { HE_TOKEN_FUNC,"fn" }},
+	{"mut", { HE_TOKEN_MUT,"mut" }},
+	{"if", { HE_TOKEN_IF,"if" }},
+	{"else", { HE_TOKEN_ELSE,"else" }},
+	{"elif", { HE_TOKEN_ELSEIF,"elif" }},
+	{"ccnd", { HE_TOKEN_EXTERN,"ccnd" }},
+	{"multiversion", { HE_TOKEN_MULTIVERSION,"multiversion" }},
+	{"import", { HE_TOKEN_IMPORT,"import" }},
+};
 
 const char* g_token_type_name_table[HE_TOKEN_COUNT];
-unordered_map<string, u32> g_operator_priority;
+extern const unordered_map<string, u32> g_operator_priority = {
+	{"+", 10},
+	{"-", 20},
+	{"*", 30},
+	{"/", 40},
+	{"==", 9},
+	{"!=", 8},
+	{"|", 6},
+};
 
 #define FILL_TOKEN_NAME_TABLE(t) g_token_type_name_table[t] = ""#t;
 
@@ -26,39 +43,18 @@ public:
 		FILL_TOKEN_NAME_TABLE(HE_TOKEN_FUNC);
 		FILL_TOKEN_NAME_TABLE(HE_TOKEN_COMMA);
 		FILL_TOKEN_NAME_TABLE(HE_TOKEN_ASSIGN);
+		FILL_TOKEN_NAME_TABLE(HE_TOKEN_MUT);
 		FILL_TOKEN_NAME_TABLE(HE_TOKEN_IF);
 		FILL_TOKEN_NAME_TABLE(HE_TOKEN_ELSE);
 		FILL_TOKEN_NAME_TABLE(HE_TOKEN_ELSEIF);
 		FILL_TOKEN_NAME_TABLE(HE_TOKEN_EXTERN);
-
-		g_operator_priority["+"] = 10;
-		g_operator_priority["-"] = 20;
-		g_operator_priority["*"] = 30;
-		g_operator_priority["/"] = 40;
-		g_operator_priority["=="] = 9;
-		g_operator_priority["!="] = 8;
-		g_operator_priority["|"] = 6;
+		FILL_TOKEN_NAME_TABLE(HE_TOKEN_MULTIVERSION);
+		FILL_TOKEN_NAME_TABLE(HE_TOKEN_IMPORT);
 	}
 };
 
 static _GlobalSettingInitializer _settingInitializer;
 
-void Lexer::Initialize(Config& config) {
-	m_keyword_map["fn"] = { HE_TOKEN_FUNC,"fn" };
-	m_keyword_map["mut"] = { HE_TOKEN_MUT,"mut" };
-	m_keyword_map["if"] = { HE_TOKEN_IF,"if" };
-	m_keyword_map["else"] = { HE_TOKEN_ELSE,"else" };
-	m_keyword_map["elif"] = {HE_TOKEN_ELSEIF,"elif"};
-	m_keyword_map["ccnd"] = { HE_TOKEN_EXTERN,"ccnd" };
-	m_lexer = make_unique<Lexer>();
-}
-
-
-Lexer& Lexer::Get() {
-	he_assert(m_lexer != nullptr);
-	return *m_lexer.get();
-}
-
 static string lexerErrorPrefix(string code, u32 line, u32 p) {
 	return "lexer : error at (" + to_string(line) + "," + to_string(p) + "):";
 }
@@ -75,56 +71,69 @@ optional<vector<Token>> Lexer::Parse(const string& content) {
 	u32 line_count = 0;
 	while (getline(ss, content_line)) {
 		line_count++;
-		u32 p = 0;
-		while (p < content_line.size()) {
-			if (content_line[p] == ' ' || content_line[p] == '\t' || content_line[p] == '\r') { p++; continue; }
-			if (content_line[p] == '\n') break;
-
-			optional<tuple<u32, Token>> res;
-			if (isalpha(content_line[p]) || content_line[p] == '_') {
-				res = alphaParser(p, content_line, error);
-			}
-			else if (isdigit(content_line[p])) {
-				res = numericParser(p, content_line, error);
-			}else if (content_line[p] == '#') {
-				//skip comments
-				break;
-			}
-			else{
-				res = signParser(p, content_line, error);
-			}
+		if (auto v = ParseLine(content_line, line_count); v.has_value()) {
+			tokens.insert(tokens.end(), v->begin(), v->end());
+		}
+		else {
+			return {};
+		}
+	}
+	return { std::move(tokens) };
+}
 
-			if (res.has_value()) {
-				auto [np, token] = res.value();
-				token.line = line_count;
-				token.start = p,token.end = np;
-				tokens.push_back(token);
-				p = np;
-			}
-			else {
-				error = lexerErrorPrefix(content_line, line_count, p) + error;
-				return {};
-			}
+optional<vector<Token>> Lexer::ParseLine(const string& content_line, u32 line_count) {
+	vector<Token> tokens;
+	u32 p = 0;
+	while (p < content_line.size()) {
+		if (content_line[p] == ' ' || content_line[p] == '\t' || content_line[p] == '\r') { p++; continue; }
+		if (content_line[p] == '\n') break;
+
+		optional<tuple<u32, Token>> res;
+		//bytes of utf-8 characters are negative chars,they are no letters
+		unsigned char c = content_line[p];
+		if (isalpha(c) || c == '_') {
+			res = alphaParser(p, content_line, error);
+		}
+		else if (isdigit(c)) {
+			res = numericParser(p, content_line, error);
+		}else if (content_line[p] == '#') {
+			//skip comments
+			break;
+		}
+		else{
+			res = signParser(p, content_line, error);
+		}
+
+		if (res.has_value()) {
+			auto [np, token] = res.value();
+			token.line = line_count;
+			token.start = p,token.end = np;
+			tokens.push_back(token);
+			p = np;
+		}
+		else {
+			error = lexerErrorPrefix(content_line, line_count, p) + error;
+			return {};
 		}
 	}
 	return { std::move(tokens) };
 }
 
 optional<tuple<u32, Token>> alphaParser(u32 p, const string& str, string& error) {
-	he_assert(p < str.size() && isalpha(str[p]));
+	he_assert(p < str.size() && (isalpha((unsigned char)str[p]) || str[p] == '_'));
 	u32 e = p;
-	while (e != str.size() && (isalpha(str[e]) || isdigit(str[e]) || str[e] == '_')) e++;
+	while (e != str.size() && (isalpha((unsigned char)str[e]) || isdigit((unsigned char)str[e]) || str[e] == '_')) e++;
 	string token = str.substr(p, e - p);
-	if (auto res = m_keyword_map.find(token);res != m_keyword_map.end()) {
+	if (auto res = g_keyword_map.find(token);res != g_keyword_map.end()) {
 		return { make_tuple(e,res->second) };
 	}
 	return { make_tuple(e,Token{HE_TOKEN_IDENTIFIER,token}) };
 }
 
 optional<tuple<u32, Token>> numericParser(u32 p, const string& str, string& error) {
-	he_assert(p < str.size() && isdigit(str[p]));
+	he_assert(p < str.size() && isdigit((unsigned char)str[p]));
 	u32 e = p;
-	while (e != str.size() && isdigit(str[e]) ) e++;
+	while (e != str.size() && isdigit((unsigned char)str[e]) ) e++;
 	string token = str.substr(p, e - p);
 	return { make_tuple(e,Token{HE_TOKEN_NUM,token}) };
 }
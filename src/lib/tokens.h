@@ -20,6 +20,8 @@ enum HE_TOKEN_TYPE {
 	HE_TOKEN_ELSE,//else,
 	HE_TOKEN_ELSEIF,//elif
 	HE_TOKEN_EXTERN,//ccnd
+	HE_TOKEN_MULTIVERSION,//multiversion
+	HE_TOKEN_IMPORT,//import
 	HE_TOKEN_COUNT
 };
 
@@ -33,15 +35,15 @@ struct Token {
 	string ToString();
 };
 
+//a lexer keeps the error of its last parse,every compilation uses its own
 class Lexer {
 private:
-	static unique_ptr<Lexer> m_lexer;
 	string error;
 public:
 	Lexer() { }
-	static void Initialize(Config& config);
-	static Lexer& Get();
 	optional<vector<Token>> Parse(const string& content);
+	//tokens of one line,line is the 1-based line number they are tagged with
+	optional<vector<Token>> ParseLine(const string& content, u32 line);
 	string ErrorMsg() { return error; }
 };
 
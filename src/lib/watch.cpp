@@ -0,0 +1,279 @@
+#include "watch.h"
+#include "io.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <unordered_map>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+using namespace llvm;
+
+//waits for the input files to change,with inotify on linux and by polling their modification
+//time elsewhere
+class FileWatcher
+{
+public:
+	FileWatcher(const vector<string>& paths)
+	{
+		for (auto& p : paths)
+		{
+			files.push_back(fs::absolute(p).lexically_normal());
+		}
+#ifdef __linux__
+		fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		for (auto& f : files)
+		{
+			//editors often replace a file by renaming a new one over it,so the directory is watched
+			int wd = inotify_add_watch(fd, f.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+			if (wd >= 0) dirs[wd] = f.parent_path();
+		}
+#else
+		for (auto& f : files)
+		{
+			times.push_back(ModifyTime(f));
+		}
+#endif
+	}
+
+	~FileWatcher()
+	{
+#ifdef __linux__
+		if (fd >= 0) close(fd);
+#endif
+	}
+
+	//indices of the files changed within timeout_ms
+	vector<u32> Wait(u32 timeout_ms)
+	{
+		vector<u8> changed(files.size(), 0);
+#ifdef __linux__
+		pollfd pfd{ fd, POLLIN, 0 };
+		if (fd < 0 || poll(&pfd, 1, timeout_ms) <= 0)
+		{
+			return {};
+		}
+		//saving a file may take a few events,let them arrive before reading
+		std::this_thread::sleep_for(chrono::milliseconds(20));
+		alignas(inotify_event) char buffer[4096];
+		ssize_t len;
+		while ((len = read(fd, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* p = buffer; p < buffer + len; p += sizeof(inotify_event) + ((inotify_event*)p)->len)
+			{
+				inotify_event* e = (inotify_event*)p;
+				if (e->len == 0) continue;
+				fs::path path = dirs[e->wd] / e->name;
+				for (u32 k = 0; k < files.size(); k++)
+				{
+					changed[k] |= files[k] == path;
+				}
+			}
+		}
+#else
+		std::this_thread::sleep_for(chrono::milliseconds(timeout_ms));
+		for (u32 k = 0; k < files.size(); k++)
+		{
+			auto t = ModifyTime(files[k]);
+			changed[k] = t != times[k];
+			times[k] = t;
+		}
+#endif
+		vector<u32> res;
+		for (u32 k = 0; k < files.size(); k++)
+		{
+			if (changed[k]) res.push_back(k);
+		}
+		return res;
+	}
+
+private:
+	vector<fs::path> files;
+#ifdef __linux__
+	int fd = -1;
+	unordered_map<int, fs::path> dirs;
+#else
+	static fs::file_time_type ModifyTime(const fs::path& path)
+	{
+		std::error_code ec;
+		return fs::last_write_time(path, ec);
+	}
+	vector<fs::file_time_type> times;
+#endif
+};
+
+struct WatchedFile
+{
+	string path;
+	//name -> (hash of the tokens,signature) of every function defined in the file
+	unordered_map<string, pair<u64, string>> funcs;
+};
+
+static ptr<AST> ParseFile(const string& path, string& error)
+{
+	auto code = IO::Get().LoadFile(path);
+	if (!code.has_value())
+	{
+		error = "fail to load file " + path;
+		return nullptr;
+	}
+	Lexer lexer;
+	auto tokens = lexer.Parse(code.value());
+	if (!tokens.has_value())
+	{
+		error = lexer.ErrorMsg();
+		return nullptr;
+	}
+	ptr<AST> ast(new AST);
+	if (!ast->Parse(tokens.value()))
+	{
+		error = ast->ErrorMsg();
+		return nullptr;
+	}
+	return ast;
+}
+
+static void Record(WatchedFile& file, AST& ast)
+{
+	file.funcs.clear();
+	for (auto& f : ast.Functions())
+	{
+		file.funcs[f->GetSignature()->LinkName()] = { f->GetHash(), f->GetSignature()->TypeKey() };
+	}
+}
+
+//replace the running process by a new one with the same arguments,returns only on failure
+static void Restart(const char** argvs)
+{
+	fflush(stdout);
+#ifdef _WIN32
+	_execvp(argvs[0], argvs);
+#else
+	execvp(argvs[0], (char* const*)argvs);
+#endif
+}
+
+//compile the functions of a changed file again,the running program keeps the old code if the
+//file has an error
+static void Reload(WatchedFile& file, ReplSession& session, const char** argvs)
+{
+	string error;
+	ptr<AST> ast = ParseFile(file.path, error);
+	if (ast == nullptr)
+	{
+		printf("helang: %s,keep running the old code\n", error.c_str());
+		return;
+	}
+
+	unordered_set<string> changed;
+	string names;
+	for (auto& f : ast->Functions())
+	{
+		string name = f->GetSignature()->LinkName();
+		auto v = file.funcs.find(name);
+		if (v != file.funcs.end() && v->second.second != f->GetSignature()->TypeKey())
+		{
+			printf("helang: the signature of %s changed in %s,restarting\n", f->GetSignature()->GetName().c_str(),
+				file.path.c_str());
+			Restart(argvs);
+			printf("helang: fail to restart,keep running the old code\n");
+			return;
+		}
+		if (v == file.funcs.end() || v->second.first != f->GetHash())
+		{
+			changed.insert(name);
+			names += (names.empty() ? "" : ",") + f->GetSignature()->GetName();
+		}
+	}
+	if (changed.empty())
+	{
+		return;
+	}
+
+	WatchedFile updated = file;
+	Record(updated, *ast);
+	ast->Retain(changed);
+	string output;
+	bool res = session.Define(*ast, output, error);
+	fputs(output.c_str(), stdout);
+	if (!res)
+	{
+		printf("helang: %s,keep running the old code\n", error.c_str());
+	}
+	else
+	{
+		printf("helang: reloaded %s from %s\n", names.c_str(), file.path.c_str());
+		file = updated;
+	}
+	fflush(stdout);
+}
+
+int RunWatch(Config& config, const vector<string>& inputs, const char** argvs)
+{
+	string error;
+	unique_ptr<ReplSession> session = ReplSession::Create(config, error);
+	if (session == nullptr)
+	{
+		printf("helang: %s\n", error.c_str());
+		return -1;
+	}
+	session->KeepReplaced();
+
+	vector<WatchedFile> files;
+	for (auto& input : inputs)
+	{
+		WatchedFile file{ input };
+		ptr<AST> ast = ParseFile(input, error);
+		if (ast == nullptr)
+		{
+			printf("helang: %s\n", error.c_str());
+			return -1;
+		}
+		Record(file, *ast);
+		string output;
+		bool res = session->Define(*ast, output, error);
+		fputs(output.c_str(), stdout);
+		if (!res)
+		{
+			printf("helang: %s\n", error.c_str());
+			return -1;
+		}
+		files.push_back(file);
+	}
+	JITTargetAddress entry = session->Lookup("__he_entry_main");
+	if (entry == 0)
+	{
+		printf("helang: main function is not defined\n");
+		return -1;
+	}
+	fflush(stdout);
+
+	//watch before main starts so no change is missed
+	FileWatcher watcher(inputs);
+	atomic<bool> done{ false };
+	int rtv = 0;
+	std::thread program([&]() {
+		rtv = jitTargetAddressToFunction<int (*)()>(entry)();
+		//the output buffer belongs to this thread
+		flush();
+		done = true;
+	});
+	while (!done)
+	{
+		for (u32 k : watcher.Wait(100))
+		{
+			Reload(files[k], *session, argvs);
+		}
+	}
+	program.join();
+	return rtv;
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "repl.h"
+
+//run main of the inputs on a thread and swap in the functions changed in the inputs while it runs
+//only the functions whose tokens changed are compiled again,the callers reach them through the
+//stubs of the session,a changed signature restarts the process with argvs
+int RunWatch(Config& config, const vector<string>& inputs, const char** argvs);
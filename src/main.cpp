@@ -1,19 +1,93 @@
 #include <filesystem>
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include "compiler.h"
+#include "link.h"
+#include "jobserver.h"
+#include "builddb.h"
+#include "interface.h"
+#include "runtime.h"
+#include "server.h"
+#include <thread>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/raw_ostream.h>
+#endif
 #include "cmdline.h"
+#include "io.h"
+#include "lto.h"
+#include <llvm/Support/TargetSelect.h>
 namespace fs = std::filesystem;
 using namespace std;
 
+#ifdef _WIN32
+
+//run a command with the console of this process,returns false if it can't be started
+static bool RunProcess(const string& cmd, DWORD& exit_code) {
+	STARTUPINFOA si;
+	PROCESS_INFORMATION pi;
+	ZeroMemory(&si, sizeof(si));
+	ZeroMemory(&pi, sizeof(pi));
+	si.cb = sizeof(si);
+	vector<char> buffer(cmd.begin(), cmd.end());
+	buffer.push_back('\0');
+	if (!CreateProcessA(NULL, buffer.data(), NULL, NULL, false, 0, NULL, NULL, &si, &pi)) {
+		return false;
+	}
+	WaitForSingleObject(pi.hProcess, INFINITE);
+	GetExitCodeProcess(pi.hProcess, &exit_code);
+	CloseHandle(pi.hProcess);
+	CloseHandle(pi.hThread);
+	return true;
+}
+
 int main(int argn,const char** argvs) {
+	//helang repl [files] starts an interactive session in helang-c,the files are loaded first
+	if (argn >= 2 && string(argvs[1]) == "repl") {
+		string cmd = (fs::path(argvs[0]).parent_path() / "helang-c").string() + " --repl";
+		if (argn > 2) {
+			cmd += " -c";
+			for (int i = 2; i < argn; i++) {
+				cmd += string(" ") + argvs[i];
+			}
+		}
+		DWORD value = 0;
+		if (!RunProcess(cmd, value)) {
+			printf("fail to create process helang-c\n");
+			return -1;
+		}
+		return value;
+	}
 	bool dump = false;
 	auto dump_call_back = [&](ParamParser*, ParameterTable* table, u32 count) {
 		dump = true;
 	};
+	bool lto = false;
+	auto lto_call_back = [&](ParamParser*, ParameterTable* table, u32 count) {
+		lto = true;
+	};
+	bool run = false;
+	auto run_call_back = [&](ParamParser*, ParameterTable* table, u32 count) {
+		run = true;
+	};
+	bool profile_generate = false;
+	auto profile_generate_call_back = [&](ParamParser*, ParameterTable* table, u32 count) {
+		profile_generate = true;
+	};
 	ParameterTable paramTable[] = {
 		ParameterTable("input", "the input .he file",nullptr,nullptr,true,{"-C","-c","--compile"}),
 		ParameterTable("output", "the output .he file",nullptr,nullptr,true,{"-O","-o","--output"}),
 		ParameterTable("help",  "print a helper message",nullptr,print_help_message,false,{"-H","-h","--help"}),
-		ParameterTable("dump",  "print generated ir to stdio",nullptr,dump_call_back,false,{"-D","-d","--dump"})
+		ParameterTable("dump",  "print generated ir to stdio",nullptr,dump_call_back,false,{"-D","-d","--dump"}),
+		ParameterTable("split", "split every module into n partitions generated in parallel","1",nullptr,true,{"-S","-s","--split"}),
+		ParameterTable("lto", "compile to bitcode and link the files with thinlto",nullptr,lto_call_back,false,{"--lto"}),
+		ParameterTable("lto_cache", "directory caching the thinlto backend results between links",nullptr,nullptr,true,{"--lto-cache"}),
+		ParameterTable("jobs", "number of thinlto backends run in parallel,0 for one per hardware thread","0",nullptr,true,{"-J","-j","--jobs"}),
+		ParameterTable("profile_generate", "build an instrumented program writing a profile to HELANG_PROFILE(default.heprof) at exit",nullptr,profile_generate_call_back,false,{"--profile-generate"}),
+		ParameterTable("profile_use", "optimize with a profile written by an instrumented program",nullptr,nullptr,true,{"--profile-use"}),
+		ParameterTable("run", "run the program with the jit of helang-c instead of building an executable",nullptr,run_call_back,false,{"-R","-r","--run"})
 	};
 	ParamParser parser(argn - 1, argvs + 1, he_countof(paramTable), paramTable);
 
@@ -23,23 +97,47 @@ int main(int argn,const char** argvs) {
 	string clang_cmd = (p / "clang").string();
 	string helang_c_cmd = (p / "helang-c").string();
 
-	string exe = parser.Require<string>("output");
+	string exe = run ? "" : parser.Require<string>("output");
 	vector<string> inputs = UnzipString(parser.Require<string>("input"));
 	vector<string> outputs;
 	for (auto& s : inputs) {
-		outputs.push_back(s + ".o");
+		outputs.push_back(s + (lto ? ".bc" : ".o"));
 	}
+	//the thinlto backends already run in parallel,splitting the bitcode makes no sense
+	u32 split = lto ? 1 : max<u32>(parser.Require<u32>("split"), 1);
 	helang_c_cmd += " -c";
 	for (auto i : inputs) {
 		helang_c_cmd += " " + i;
 	}
-	helang_c_cmd += " -o";
-	for (auto o : outputs) {
-		helang_c_cmd += " " + o;
+	if (run) {
+		helang_c_cmd += " --run";
+	}
+	else {
+		helang_c_cmd += " -o";
+		for (auto o : outputs) {
+			helang_c_cmd += " " + o;
+		}
 	}
 	if (dump) {
 		helang_c_cmd += " -d";
 	}
+	helang_c_cmd += " -s " + to_string(split);
+	if (lto) {
+		helang_c_cmd += " --emit bc";
+	}
+	if (profile_generate) {
+		helang_c_cmd += " --profile-generate";
+	}
+	if (auto v = parser.Get<string>("profile_use"); v.has_value()) {
+		helang_c_cmd += " --profile-use " + v.value();
+	}
+	//helang-c writes partition k of every file next to its object
+	vector<string> objects;
+	for (auto& o : outputs) {
+		for (u32 k = 0; k < split; k++) {
+			objects.push_back(PartitionObjectName(o, k));
+		}
+	}
 	char buffer[65536];
 	memcpy(buffer, helang_c_cmd.c_str(), helang_c_cmd.size());
 	buffer[helang_c_cmd.size()] = '\0';
@@ -72,18 +170,47 @@ int main(int argn,const char** argvs) {
 
 	DWORD value = 0;
 	GetExitCodeProcess(pi.hProcess, &value);
+	//helang-c --run exits with the value of main
+	if (run) {
+		return value;
+	}
 	if (value != 0) {
-		for (auto& o : outputs) {
+		for (auto& o : objects) {
 			DeleteFileA(o.c_str());
 		}
 		printf("fail to compile helang\n");
 		return 1;
 	}
 
-	for (auto o : outputs) {
+	if (lto) {
+		llvm::InitializeAllTargetInfos();
+		llvm::InitializeAllTargets();
+		llvm::InitializeAllTargetMCs();
+		llvm::InitializeAllAsmParsers();
+		llvm::InitializeAllAsmPrinters();
+
+		string error;
+		vector<string> native;
+		bool linked = ThinLink(outputs, exe + ".lto", parser.Get<string>("lto_cache").value_or(""),
+			parser.Require<u32>("jobs"), native, error);
+		for (auto& o : objects) {
+			DeleteFileA(o.c_str());
+		}
+		if (!linked) {
+			for (auto& o : native) {
+				DeleteFileA(o.c_str());
+			}
+			printf("helang: %s\n", error.c_str());
+			return 1;
+		}
+		objects = native;
+	}
+
+	for (auto o : objects) {
 		clang_cmd += " " + o;
 	}
-	clang_cmd += " " + (p / "io.c").string() + " " + (p / "main.c").string();
+	//helang-c links the runtime functions the objects call into them,the archive provides main
+	clang_cmd += " " + (p / "helang_rt.lib").string();
 
 	
 	clang_cmd += " -o " + exe;
@@ -105,7 +232,7 @@ int main(int argn,const char** argvs) {
 		&si, // ½̵ʾSTARTUPINFOṹ  
 		&pi  // ½̵ʶϢPROCESS_INFORMATIONṹ
 	)) {
-		for (auto& o : outputs) {
+		for (auto& o : objects) {
 			DeleteFileA(o.c_str());
 		}
 		printf("fail to create process clang\n");
@@ -113,8 +240,485 @@ int main(int argn,const char** argvs) {
 	}
 	
 	WaitForSingleObject(pi.hProcess, INFINITE);
-	for (auto& o : outputs) {
+	for (auto& o : objects) {
 		DeleteFileA(o.c_str());
 	}
 	return 0;
-}
\ No newline at end of file
+}
+
+#else
+
+//repl and --run are handled by helang-c,this process is replaced by it
+static int ExecCompiler(const fs::path& dir, vector<string> args) {
+	args.insert(args.begin(), (dir / "helang-c").string());
+	vector<char*> argv;
+	for (auto& a : args) {
+		argv.push_back(a.data());
+	}
+	argv.push_back(nullptr);
+	execv(argv[0], argv.data());
+	printf("fail to start helang-c\n");
+	return -1;
+}
+
+//compile input in memory,to one object per partition or to bitcode with its thinlto summary
+static bool CompileInMemory(const string& input, Config& config, llvm::TargetMachine* target_machine,
+	vector<vector<char>>& objects, ptr<AST>& ast, string& log) {
+	auto code = IO::Get().LoadFile(input);
+	if (!code.has_value()) {
+		log += "helang: fail to load file " + input + "\n";
+		return false;
+	}
+	ast = ParseModule(code.value(), log);
+	if (ast == nullptr) {
+		return false;
+	}
+	if (string error; !ImportModules(*ast, input, config.interfaces, error)) {
+		log += "helang: " + error + "\n";
+		return false;
+	}
+	ptr<LLVMCodeGenContext> context = GenerateParsedModule(input, *ast, config, target_machine, log);
+	if (context == nullptr) {
+		return false;
+	}
+
+	vector<llvm::SmallString<0>> buffers(config.emit == "bc" ? 1 : config.split);
+	vector<unique_ptr<llvm::raw_svector_ostream>> streams;
+	vector<llvm::raw_pwrite_stream*> dests;
+	for (auto& b : buffers) {
+		streams.push_back(make_unique<llvm::raw_svector_ostream>(b));
+		dests.push_back(streams.back().get());
+	}
+	if (config.emit == "bc") {
+		EmitSummaryBitcode(*context->llvm_module, *dests[0]);
+	}
+	else if (config.split > 1) {
+		if (!EmitSplitObjects(*context->llvm_module, dests, config, log)) {
+			return false;
+		}
+	}
+	else if (!EmitObject(*context->llvm_module, target_machine, *dests[0], log)) {
+		return false;
+	}
+	for (auto& b : buffers) {
+		objects.emplace_back(b.begin(), b.end());
+	}
+	//the interface goes next to the objects --save-temps writes
+	if (string error; config.interfaces && !WriteInterface(input, HashContent(code.value()), ast->Functions(), error)) {
+		log += "helang: " + error + "\n";
+		return false;
+	}
+	return true;
+}
+
+static bool SaveFile(const string& name, const vector<char>& data) {
+	std::error_code EC;
+	llvm::raw_fd_ostream os(name, EC);
+	if (EC) {
+		printf("helang: can't open file %s\n", name.c_str());
+		return false;
+	}
+	os.write(data.data(), data.size());
+	return true;
+}
+
+//compile the inputs on up to jobs threads,or under make on one thread plus one for every token
+//of the jobserver,the objects and the ast of input i are kept in compiled[i] and asts[i]
+//logs are printed in input order and no new input is started after a failure
+static bool CompileAll(const vector<string>& inputs, Config& config, u32 jobs, JobServer* jobserver,
+	vector<vector<vector<char>>>& compiled, vector<ptr<AST>>& asts) {
+	u32 count = inputs.size();
+	vector<string> logs(count);
+	vector<u8> results(count, 0), finished(count, 0);
+	vector<thread> threads(count);
+	//workers write their index when they finish
+	int done[2];
+	if (pipe2(done, O_CLOEXEC) != 0) {
+		printf("helang: fail to create a pipe\n");
+		return false;
+	}
+
+	auto start = [&](u32 i) {
+		threads[i] = thread([&, i]() {
+			string error;
+			unique_ptr<llvm::TargetMachine> target_machine = CreateTargetMachine(config, error);
+			if (target_machine == nullptr) {
+				logs[i] = "helang: " + error + "\n";
+			}
+			else {
+				results[i] = CompileInMemory(inputs[i], config, target_machine.get(), compiled[i], asts[i], logs[i]);
+			}
+			WriteAll(done[1], &i, sizeof(i));
+		});
+	};
+
+	u32 next = 0, running = 0, printed = 0;
+	bool failed = false;
+	while (running > 0 || (next < count && !failed)) {
+		if (next < count && !failed) {
+			//the first worker runs on the implicit job of this process
+			u32 slots = jobserver != nullptr ? jobserver->Held() + 1 : jobs;
+			if (running < slots || (jobserver != nullptr && jobserver->Acquire(done[0]))) {
+				start(next++);
+				running++;
+				continue;
+			}
+		}
+		u32 i;
+		ReadAll(done[0], &i, sizeof(i));
+		threads[i].join();
+		running--;
+		finished[i] = 1;
+		failed = failed || !results[i];
+		while (printed < count && finished[printed]) {
+			fputs(logs[printed++].c_str(), stdout);
+		}
+		//the token of a finished worker is kept for the next input while there is one
+		while (jobserver != nullptr && (next == count || failed) && jobserver->Held() + 1 > max<u32>(running, 1)) {
+			jobserver->Release();
+		}
+	}
+	fflush(stdout);
+	close(done[0]);
+	close(done[1]);
+	return !failed;
+}
+
+//every function declared with ccnd must have the signature of its definition in another input
+static bool CheckDeclarations(BuildRecord& record, const vector<string>& paths, const vector<string>& inputs) {
+	map<string, u32> definer;
+	for (u32 i = 0; i < paths.size(); i++) {
+		for (auto& [name, key] : record.files[paths[i]].defined) {
+			definer.emplace(name, i);
+		}
+	}
+	bool ok = true;
+	for (u32 i = 0; i < paths.size(); i++) {
+		for (auto& [name, key] : record.files[paths[i]].declared) {
+			auto d = definer.find(name);
+			if (d == definer.end()) continue;
+			const string& defined = record.files[paths[d->second]].defined[name];
+			if (defined != key) {
+				printf("helang: %s declares %s%s but %s defines %s%s\n", inputs[i].c_str(), name.c_str(), key.c_str(),
+					inputs[d->second].c_str(), name.c_str(), defined.c_str());
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
+
+//the whole build runs in this process,the objects stay in memory and are linked with the
+//precompiled runtime,only --save-temps writes them next to the inputs
+int main(int argn, const char** argvs) {
+	fs::path p(argvs[0]);
+	p = p.parent_path();
+
+	if (argn >= 2 && string(argvs[1]) == "repl") {
+		vector<string> args = { "--repl" };
+		if (argn > 2) {
+			args.push_back("-c");
+			args.insert(args.end(), argvs + 2, argvs + argn);
+		}
+		return ExecCompiler(p, args);
+	}
+	bool dump = false;
+	auto dump_call_back = [&](ParamParser*, ParameterTable* table, u32 count) {
+		dump = true;
+	};
+	bool lto = false;
+	auto lto_call_back = [&](ParamParser*, ParameterTable* table, u32 count) {
+		lto = true;
+	};
+	bool run = false;
+	auto run_call_back = [&](ParamParser*, ParameterTable* table, u32 count) {
+		run = true;
+	};
+	bool profile_generate = false;
+	auto profile_generate_call_back = [&](ParamParser*, ParameterTable* table, u32 count) {
+		profile_generate = true;
+	};
+	bool save_temps = false;
+	auto save_temps_call_back = [&](ParamParser*, ParameterTable* table, u32 count) {
+		save_temps = true;
+	};
+	bool explain = false;
+	auto explain_call_back = [&](ParamParser*, ParameterTable* table, u32 count) {
+		explain = true;
+	};
+	bool freestanding = false;
+	auto freestanding_call_back = [&](ParamParser*, ParameterTable* table, u32 count) {
+		freestanding = true;
+	};
+	ParameterTable paramTable[] = {
+		ParameterTable("input", "the input .he file",nullptr,nullptr,true,{"-C","-c","--compile"}),
+		ParameterTable("output", "the output .he file",nullptr,nullptr,true,{"-O","-o","--output"}),
+		ParameterTable("help",  "print a helper message",nullptr,print_help_message,false,{"-H","-h","--help"}),
+		ParameterTable("dump",  "print generated ir to stdio",nullptr,dump_call_back,false,{"-D","-d","--dump"}),
+		ParameterTable("split", "split every module into n partitions generated in parallel","1",nullptr,true,{"-S","-s","--split"}),
+		ParameterTable("lto", "compile to bitcode and link the files with thinlto",nullptr,lto_call_back,false,{"--lto"}),
+		ParameterTable("lto_cache", "directory caching the thinlto backend results between links",nullptr,nullptr,true,{"--lto-cache"}),
+		ParameterTable("jobs", "number of files compiled and thinlto backends run in parallel,0 for one per hardware thread,under make -j the jobserver decides","0",nullptr,true,{"-J","-j","--jobs"}),
+		ParameterTable("profile_generate", "build an instrumented program writing a profile to HELANG_PROFILE(default.heprof) at exit",nullptr,profile_generate_call_back,false,{"--profile-generate"}),
+		ParameterTable("profile_use", "optimize with a profile written by an instrumented program",nullptr,nullptr,true,{"--profile-use"}),
+		ParameterTable("run", "run the program with the jit of helang-c instead of building an executable",nullptr,run_call_back,false,{"-R","-r","--run"}),
+		ParameterTable("save_temps", "write the objects next to the inputs,<input>.o or <input>.bc with --lto",nullptr,save_temps_call_back,false,{"--save-temps"}),
+		ParameterTable("explain", "print why every input is compiled again or the link is skipped",nullptr,explain_call_back,false,{"--explain"}),
+		ParameterTable("freestanding", "link a static executable with the runtime of libhelang_rt_freestanding.a instead of libc,it starts without the dynamic loader and stdio",nullptr,freestanding_call_back,false,{"--freestanding"})
+	};
+	ParamParser parser(argn - 1, argvs + 1, he_countof(paramTable), paramTable);
+
+	if (run) {
+		vector<string> args = { "-c", parser.Require<string>("input"), "--run" };
+		if (dump) {
+			args.push_back("-d");
+		}
+		if (profile_generate) {
+			args.push_back("--profile-generate");
+		}
+		if (auto v = parser.Get<string>("profile_use"); v.has_value()) {
+			args.insert(args.end(), { "--profile-use", v.value() });
+		}
+		return ExecCompiler(p, args);
+	}
+
+	string exe = parser.Require<string>("output");
+	vector<string> inputs = UnzipString(parser.Require<string>("input"));
+	//the counters are written with stdio at exit
+	if (freestanding && profile_generate) {
+		printf("helang: --profile-generate needs libc,it can't be used with --freestanding\n");
+		return 1;
+	}
+
+	llvm::InitializeAllTargetInfos();
+	llvm::InitializeAllTargets();
+	llvm::InitializeAllTargetMCs();
+	llvm::InitializeAllAsmParsers();
+	llvm::InitializeAllAsmPrinters();
+
+	//the defaults of helang-c
+	Config config;
+	config.search_path = p.string();
+	config.dump = dump;
+	config.specialize_limit = 4;
+	config.specialize_report = false;
+	config.warn_tail = false;
+	config.multiversion = false;
+	config.multiversion_levels = { "v2","v3","v4" };
+	config.cpu = "generic";
+	//the thinlto backends already run in parallel,splitting the bitcode makes no sense
+	config.split = lto ? 1 : max<u32>(parser.Require<u32>("split"), 1);
+	config.emit = lto ? "bc" : "obj";
+	//the build writes nothing next to the inputs but what --save-temps asks for
+	config.interfaces = save_temps;
+	config.profile_generate = profile_generate;
+	config.jit_lazy = false;
+	//the runtime functions the inputs call are linked into their objects,the bitcode runtime
+	//calls printf so a freestanding program calls the archive
+	if (!freestanding) {
+		config.runtime = LoadRuntime((p / "helang_rt.bc").string());
+	}
+	if (!IO::Initialize(config)) {
+		printf("fail to initialize io system");
+		return -1;
+	}
+	if (auto v = parser.Get<string>("profile_use"); v.has_value()) {
+		string error;
+		if (auto profile = Profile::Load(v.value(), error); profile.has_value()) {
+			config.profile = make_shared<Profile>(std::move(profile.value()));
+		}
+		else {
+			printf("helang: %s\n", error.c_str());
+			return 1;
+		}
+	}
+	u32 jobs = parser.Require<u32>("jobs");
+	if (jobs == 0) {
+		jobs = max<u32>(thread::hardware_concurrency(), 1);
+	}
+	bool unavailable;
+	unique_ptr<JobServer> jobserver = JobServer::Connect(unavailable);
+	if (unavailable) {
+		//like make itself,a job that can't reach the jobserver runs alone
+		printf("helang: warning: jobserver unavailable,using -j1,add + to the rule to use it\n");
+		jobs = 1;
+	}
+
+	//the inputs which didn't change since the last build take their objects from the database
+	string db = exe + ".hedb";
+	BuildRecord record;
+	record.options = "split=" + to_string(config.split) + " lto=" + to_string(lto) +
+		" profile_generate=" + to_string(profile_generate) + " helang=" + FileStamp("/proc/self/exe") +
+		" runtime=" + (freestanding ? "freestanding" : FileStamp((p / "helang_rt.bc").string()));
+	if (auto v = parser.Get<string>("profile_use"); v.has_value()) {
+		record.options += " profile_use=" + to_string(HashContent(IO::Get().LoadFile(v.value()).value_or("")));
+	}
+	optional<BuildRecord> last = LoadBuildRecord(db);
+	if (!last.has_value()) {
+		if (explain) printf("helang: explain: no build database %s,every input is compiled\n", db.c_str());
+	}
+	else if (last->options != record.options) {
+		if (explain) printf("helang: explain: the options changed,every input is compiled\n");
+		last.reset();
+	}
+	else if (dump) {
+		if (explain) printf("helang: explain: --dump prints the ir of every input,every input is compiled\n");
+		last.reset();
+	}
+
+	vector<string> paths;
+	vector<u64> hashes;
+	vector<u32> todo;
+	vector<vector<vector<char>>> compiled(inputs.size());
+	for (u32 i = 0; i < inputs.size(); i++) {
+		paths.push_back(fs::absolute(inputs[i]).lexically_normal().string());
+		hashes.push_back(HashContent(IO::Get().LoadFile(inputs[i]).value_or("")));
+		if (!last.has_value()) {
+			todo.push_back(i);
+			continue;
+		}
+		string reason;
+		auto f = last->files.find(paths[i]);
+		if (f == last->files.end()) {
+			reason = "it is a new input";
+		}
+		else if (f->second.hash != hashes[i]) {
+			reason = "its content changed";
+		}
+		else if (string changed = ChangedImport(f->second); !changed.empty()) {
+			reason = "the interface of " + fs::path(changed).filename().string() + " changed";
+		}
+		else if (auto v = LoadBuildObjects(db, paths[i], f->second.objects); v.has_value()) {
+			compiled[i] = std::move(v.value());
+			record.files[paths[i]] = f->second;
+			continue;
+		}
+		else {
+			reason = "its objects are missing";
+		}
+		if (explain) printf("helang: explain: %s is compiled,%s\n", inputs[i].c_str(), reason.c_str());
+		todo.push_back(i);
+	}
+
+	vector<string> todo_inputs;
+	for (u32 i : todo) {
+		todo_inputs.push_back(inputs[i]);
+	}
+	vector<vector<vector<char>>> todo_compiled(todo.size());
+	vector<ptr<AST>> asts(todo.size());
+	if (!CompileAll(todo_inputs, config, jobs, jobserver.get(), todo_compiled, asts)) {
+		printf("fail to compile helang\n");
+		return 1;
+	}
+	string error;
+	for (u32 k = 0; k < todo.size(); k++) {
+		u32 i = todo[k];
+		BuildFile& file = record.files[paths[i]];
+		file.hash = hashes[i];
+		file.objects = todo_compiled[k].size();
+		RecordSignatures(*asts[k], paths[i], file);
+		if (!SaveBuildObjects(db, paths[i], todo_compiled[k], error)) {
+			printf("helang: %s\n", error.c_str());
+			return 1;
+		}
+		compiled[i] = std::move(todo_compiled[k]);
+	}
+
+	//the objects of an input depend on its text and the interfaces it imports only,an input calling
+	//a function whose signature changed keeps them,its ccnd declarations are checked against the
+	//new signature
+	if (explain && last.has_value()) {
+		for (u32 k : todo) {
+			auto old = last->files.find(paths[k]);
+			for (auto& [name, key] : record.files[paths[k]].defined) {
+				if (old != last->files.end() && old->second.defined.count(name) != 0 && old->second.defined[name] == key) {
+					continue;
+				}
+				for (u32 i = 0; i < inputs.size(); i++) {
+					bool compiled_again = find(todo.begin(), todo.end(), i) != todo.end();
+					if (!compiled_again && record.files[paths[i]].declared.count(name) != 0) {
+						printf("helang: explain: %s is checked,the signature of %s changed in %s\n", inputs[i].c_str(),
+							name.c_str(), inputs[k].c_str());
+					}
+				}
+			}
+		}
+	}
+	if (!CheckDeclarations(record, paths, inputs)) {
+		printf("fail to compile helang\n");
+		return 1;
+	}
+	if (last.has_value()) {
+		for (auto& [path, file] : last->files) {
+			if (record.files.count(path) == 0) RemoveBuildObjects(db, path, file.objects);
+		}
+	}
+
+	record.order = paths;
+	if (todo.empty() && last.has_value()) {
+		string reason;
+		if (last->order != paths) {
+			reason = "the inputs changed";
+		}
+		else if (last->output_stamp.empty() || FileStamp(exe) != last->output_stamp) {
+			reason = "it changed since the last build";
+		}
+		else if (save_temps) {
+			reason = "--save-temps writes the objects";
+		}
+		else {
+			if (explain) printf("helang: explain: nothing changed,%s isn't linked again\n", exe.c_str());
+			return 0;
+		}
+		if (explain) printf("helang: explain: %s is linked again,%s\n", exe.c_str(), reason.c_str());
+	}
+
+	vector<vector<char>> objects;
+	vector<pair<string, vector<char>>> bitcode;
+	for (u32 i = 0; i < inputs.size(); i++) {
+		string output = inputs[i] + (lto ? ".bc" : ".o");
+		for (u32 k = 0; k < compiled[i].size() && save_temps; k++) {
+			if (!SaveFile(PartitionObjectName(output, k), compiled[i][k])) return 1;
+		}
+		if (lto) {
+			bitcode.emplace_back(output, std::move(compiled[i][0]));
+		}
+		else {
+			objects.insert(objects.end(), std::make_move_iterator(compiled[i].begin()), std::make_move_iterator(compiled[i].end()));
+		}
+	}
+
+	if (lto) {
+		//the backends take the tokens free now
+		u32 backends = jobs;
+		if (jobserver != nullptr) {
+			while (jobserver->Held() + 1 < max<u32>(thread::hardware_concurrency(), 1) && jobserver->TryAcquire());
+			backends = jobserver->Held() + 1;
+		}
+		bool linked = ThinLinkBuffers(bitcode, parser.Get<string>("lto_cache").value_or(""), backends, objects, error);
+		while (jobserver != nullptr && jobserver->Held() > 0) {
+			jobserver->Release();
+		}
+		if (!linked) {
+			printf("helang: %s\n", error.c_str());
+			return 1;
+		}
+		for (u32 task = 0; task < objects.size() && save_temps; task++) {
+			if (!SaveFile(exe + ".lto." + to_string(task) + ".o", objects[task])) return 1;
+		}
+	}
+
+	string runtime = (p / (freestanding ? "libhelang_rt_freestanding.a" : "libhelang_rt.a")).string();
+	if (!LinkExecutable(objects, runtime, exe, freestanding, error)) {
+		printf("helang: %s\n", error.c_str());
+		return 1;
+	}
+	record.output_stamp = FileStamp(exe);
+	if (!SaveBuildRecord(db, record, error)) {
+		printf("helang: %s\n", error.c_str());
+		return 1;
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static void cpuid(int leaf, int sub, unsigned int r[4]){
+    __cpuidex((int*)r, leaf, sub);
+}
+static unsigned long long xgetbv(){
+    return _xgetbv(0);
+}
+#else
+#include <cpuid.h>
+static void cpuid(int leaf, int sub, unsigned int r[4]){
+    __cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+}
+static unsigned long long xgetbv(){
+    unsigned int lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+}
+#endif
+
+#define HAS(reg, bit) (((reg) >> (bit)) & 1)
+
+//highest x86-64 micro-architecture level of this cpu
+static int detect_level(){
+    unsigned int l1[4], l7[4] = {0}, e1[4] = {0};
+    cpuid(0, 0, l1);
+    int max_leaf = l1[0];
+    cpuid(1, 0, l1);
+    if(max_leaf >= 7) cpuid(7, 0, l7);
+    cpuid(0x80000000, 0, e1);
+    if(e1[0] >= 0x80000001) cpuid(0x80000001, 0, e1);
+    else e1[2] = 0;
+
+    unsigned int ecx = l1[2], ebx7 = l7[1], ecx_ext = e1[2];
+    int v2 = HAS(ecx, 0) && HAS(ecx, 9) && HAS(ecx, 13) && HAS(ecx, 19) && HAS(ecx, 20)
+        && HAS(ecx, 23) && HAS(ecx_ext, 0);
+    if(!v2) return 1;
+
+    int osxsave = HAS(ecx, 27);
+    unsigned long long xcr0 = osxsave ? xgetbv() : 0;
+    int v3 = osxsave && (xcr0 & 0x6) == 0x6 && HAS(ecx, 12) && HAS(ecx, 22) && HAS(ecx, 28)
+        && HAS(ecx, 29) && HAS(ebx7, 3) && HAS(ebx7, 5) && HAS(ebx7, 8) && HAS(ecx_ext, 5);
+    if(!v3) return 2;
+
+    int v4 = (xcr0 & 0xe6) == 0xe6 && HAS(ebx7, 16) && HAS(ebx7, 17) && HAS(ebx7, 28)
+        && HAS(ebx7, 30) && HAS(ebx7, 31);
+    return v4 ? 4 : 3;
+}
+#else
+static int detect_level(){
+    return 1;
+}
+#endif
+
+//called by the constructor of modules with multiversioned functions
+//HELANG_CPU_LEVEL caps the level,e.g. to compare the clones on one machine
+int __he_cpu_level(){
+    int level = detect_level();
+    const char* cap = getenv("HELANG_CPU_LEVEL");
+    if(cap != NULL && atoi(cap) > 0 && atoi(cap) < level){
+        level = atoi(cap);
+    }
+    return level;
+}
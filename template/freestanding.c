@@ -0,0 +1,345 @@
+//runtime of helang --freestanding,linux on x86-64 and aarch64 without libc
+//_start,integer formatting and parsing and the read,write and exit_group system calls take
+//the place of crt1.o,printf and scanf,the executable is static and needs no dynamic loader
+//it provides the functions of io.c and main.c and the getenv and atoi(strtol) cpu.c calls
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern int __he_entry_main();
+
+#if defined(__x86_64__)
+#define SYS_read 0
+#define SYS_write 1
+#define SYS_ioctl 16
+#define SYS_exit_group 231
+#define SYS_openat 257
+
+static long syscall3(long n, long a, long b, long c){
+    long r;
+    __asm__ volatile("syscall" : "=a"(r) : "a"(n), "D"(a), "S"(b), "d"(c) : "rcx", "r11", "memory");
+    return r;
+}
+
+//the kernel starts the process with argc,argv and envp on the stack
+__asm__(
+    ".text\n"
+    ".global _start\n"
+    "_start:\n"
+    "    xor %rbp, %rbp\n"
+    "    mov %rsp, %rdi\n"
+    "    and $-16, %rsp\n"
+    "    call __he_start\n"
+    "    hlt\n");
+#elif defined(__aarch64__)
+#define SYS_ioctl 29
+#define SYS_read 63
+#define SYS_write 64
+#define SYS_exit_group 94
+#define SYS_openat 56
+
+static long syscall3(long n, long a, long b, long c){
+    register long x8 __asm__("x8") = n;
+    register long x0 __asm__("x0") = a;
+    register long x1 __asm__("x1") = b;
+    register long x2 __asm__("x2") = c;
+    __asm__ volatile("svc 0" : "+r"(x0) : "r"(x8), "r"(x1), "r"(x2) : "memory");
+    return x0;
+}
+
+__asm__(
+    ".text\n"
+    ".global _start\n"
+    "_start:\n"
+    "    mov x29, #0\n"
+    "    mov x30, #0\n"
+    "    mov x0, sp\n"
+    "    bl __he_start\n"
+    "    brk #0\n");
+#else
+#error "--freestanding supports linux on x86-64 and aarch64"
+#endif
+
+#define EINTR 4
+#define TCGETS 0x5401
+#define AT_FDCWD -100
+
+static char** environment;
+
+//stdout is line buffered on a terminal and fully buffered otherwise,as in libc
+static char out[4096];
+static size_t out_len;
+static int line_buffered;
+
+//also called by programs to write what they printed so far
+void flush(){
+    size_t done = 0;
+    while(done < out_len){
+        long n = syscall3(SYS_write, 1, (long)(out + done), out_len - done);
+        if(n == -EINTR) continue;
+        if(n <= 0) break;
+        done += n;
+    }
+    out_len = 0;
+}
+
+static void put(const char* s, size_t n){
+    for(size_t i = 0; i < n; i++){
+        if(out_len == sizeof(out)){
+            flush();
+        }
+        out[out_len++] = s[i];
+        if(s[i] == '\n' && line_buffered){
+            flush();
+        }
+    }
+}
+
+static void put_str(const char* s){
+    size_t n = 0;
+    while(s[n] != '\0') n++;
+    put(s, n);
+}
+
+static void put_int(int v){
+    char b[12];
+    int i = sizeof(b);
+    unsigned int u = v < 0 ? 0u - (unsigned int)v : (unsigned int)v;
+    do{
+        b[--i] = '0' + u % 10;
+        u /= 10;
+    }while(u != 0);
+    if(v < 0) b[--i] = '-';
+    put(b + i, sizeof(b) - i);
+}
+
+char* getenv(const char* name);
+
+//stdin or the file HELANG_INPUT names,prompts are only printed when it is a terminal
+static char in[65536];
+static size_t in_pos, in_len;
+static long in_fd;
+//0 before the first read
+static int in_opened;
+static int in_prompt;
+
+static void in_open(){
+    in_opened = 1;
+    const char* path = getenv("HELANG_INPUT");
+    in_fd = path != NULL ? syscall3(SYS_openat, AT_FDCWD, (long)path, 0) : 0;
+    char termios[64];
+    in_prompt = in_fd >= 0 && syscall3(SYS_ioctl, in_fd, TCGETS, (long)termios) == 0;
+}
+
+//next byte of the input,-1 at the end
+static int get(){
+    if(in_pos == in_len){
+        long n;
+        if(in_fd < 0) return -1;
+        while((n = syscall3(SYS_read, in_fd, (long)in, sizeof(in))) == -EINTR);
+        if(n <= 0) return -1;
+        in_pos = 0;
+        in_len = n;
+    }
+    return (unsigned char)in[in_pos++];
+}
+
+static void unget(){
+    in_pos--;
+}
+
+//the constructors of the modules,e.g. the multiversion resolvers,the linker defines the bounds
+//for -static -nostdlib
+typedef void (*HeInit)();
+extern __attribute__((visibility("hidden"))) HeInit __init_array_start[];
+extern __attribute__((visibility("hidden"))) HeInit __init_array_end[];
+
+__attribute__((noreturn, used)) void __he_start(long* sp){
+    long argc = sp[0];
+    environment = (char**)(sp + 1 + argc + 1);
+    char termios[64];
+    line_buffered = syscall3(SYS_ioctl, 1, TCGETS, (long)termios) == 0;
+
+    //after the environment and stdout are set up,constructors may read HELANG_CPU_LEVEL and print
+    for(HeInit* f = __init_array_start; f != __init_array_end; f++){
+        (*f)();
+    }
+    int num = __he_entry_main();
+    put_str("so cool!helang exits and returns ");
+    put_int(num);
+    flush();
+    for(;;){
+        syscall3(SYS_exit_group, 0, 0, 0);
+    }
+}
+
+void print_i32(int n){
+    put_str("saint he says: ");
+    put_int(n);
+    put_str("!\n");
+}
+
+void print_i32_n(const int32_t* values, int64_t count){
+    for(int64_t i = 0; i < count; i++){
+        print_i32(values[i]);
+    }
+}
+
+//the highest nonzero byte and the ones below it,a value of 0 prints a single 0
+static int split_bytes(uint64_t n, int a[8]){
+    int h = -1;
+    for(int b = 0; b < 8; b++){
+        int offset = (7 - b) * 8;
+        a[b] = (n >> offset) & 0xff;
+        if(a[b] != 0 && h < 0){
+            h = b;
+        }
+    }
+    return h < 0 ? 7 : h;
+}
+
+void print_u8(uint64_t n){
+    int a[8];
+    int h = split_bytes(n, a);
+    put_str("saint he says:u8 ");
+    put_int(a[h]);
+    for(int i = h + 1; i < 8; i++){
+        put_str("|");
+        put_int(a[i]);
+    }
+    put_str("\n");
+}
+
+void test_5g(){
+    put_str("Blocked by America.Please buy HuaWei to enable 5g\n");
+}
+
+//the next number of the input,bytes before it other than digits and signs are skipped,the rest
+//of the line stays for the next call,returns 0 at the end of the input
+static int read_i32(int32_t* value){
+    int c;
+    int negative;
+    //a sign without a digit after it,as the - of "1 - 2",is skipped like any other byte
+    do{
+        while((c = get()) >= 0 && !(c >= '0' && c <= '9') && c != '-' && c != '+');
+        if(c < 0) return 0;
+        negative = c == '-';
+        if(c == '-' || c == '+'){
+            c = get();
+            if(c < 0) return 0;
+            if(!(c >= '0' && c <= '9')) unget();
+        }
+    }while(!(c >= '0' && c <= '9'));
+    uint32_t num = 0;
+    for(; c >= '0' && c <= '9'; c = get()){
+        num = num * 10 + (c - '0');
+    }
+    if(c >= 0) unget();
+    *value = negative ? (int32_t)(0u - num) : (int32_t)num;
+    return 1;
+}
+
+int input_i32(){
+    if(!in_opened) in_open();
+    if(in_prompt){
+        put_str("input a i32 number:");
+        flush();
+    }
+    int32_t num = 0;
+    read_i32(&num);
+    return num;
+}
+
+int64_t input_i32_n(int32_t* values, int64_t count){
+    if(!in_opened) in_open();
+    if(in_prompt) flush();
+    int64_t i = 0;
+    while(i < count && read_i32(values + i)){
+        i++;
+    }
+    return i;
+}
+
+void powerCon(uint64_t na, int force){
+    int a[8];
+    int h = split_bytes(na, a);
+
+    static int keyboard[68] = {0};
+    for(int i = h; i < 8; i++){
+        if(a[i] < 68) keyboard[a[i]] = force;
+    }
+
+    put_str("keyboard powers : [");
+    put_int(keyboard[0]);
+    for(int i = 1; i < 26; i++){
+        put_str(",");
+        put_int(keyboard[i]);
+    }
+    put_str("]\n");
+}
+
+char* getenv(const char* name){
+    for(char** e = environment; e != NULL && *e != NULL; e++){
+        const char* n = name;
+        const char* v = *e;
+        while(*n != '\0' && *n == *v){
+            n++;
+            v++;
+        }
+        if(*n == '\0' && *v == '='){
+            return (char*)v + 1;
+        }
+    }
+    return NULL;
+}
+
+//decimal only,the glibc headers turn atoi into strtol(s, NULL, 10)
+long strtol(const char* s, char** end, int base){
+    while(*s == ' ' || *s == '\t' || *s == '\n') s++;
+    int negative = *s == '-';
+    if(*s == '-' || *s == '+') s++;
+    unsigned long n = 0;
+    for(; *s >= '0' && *s <= '9'; s++){
+        n = n * 10 + (*s - '0');
+    }
+    if(end != NULL) *end = (char*)s;
+    return negative ? (long)(0ul - n) : (long)n;
+}
+
+int atoi(const char* s){
+    return (int)strtol(s, NULL, 10);
+}
+
+//the code generators call these for copies and zeroing of aggregates
+void* memcpy(void* dst, const void* src, size_t n){
+    char* d = dst;
+    const char* s = src;
+    for(size_t i = 0; i < n; i++) d[i] = s[i];
+    return dst;
+}
+
+void* memmove(void* dst, const void* src, size_t n){
+    char* d = dst;
+    const char* s = src;
+    if(d < s){
+        for(size_t i = 0; i < n; i++) d[i] = s[i];
+    }else{
+        for(size_t i = n; i > 0; i--) d[i - 1] = s[i - 1];
+    }
+    return dst;
+}
+
+void* memset(void* dst, int c, size_t n){
+    char* d = dst;
+    for(size_t i = 0; i < n; i++) d[i] = (char)c;
+    return dst;
+}
+
+int memcmp(const void* a, const void* b, size_t n){
+    const unsigned char* x = a;
+    const unsigned char* y = b;
+    for(size_t i = 0; i < n; i++){
+        if(x[i] != y[i]) return x[i] - y[i];
+    }
+    return 0;
+}
@@ -2,61 +2,373 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+#define read _read
+#define open _open
+#define isatty _isatty
+#else
+#include <unistd.h>
+#define O_BINARY 0
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _MSC_VER
+#define HE_THREAD_LOCAL __declspec(thread)
+#else
+#define HE_THREAD_LOCAL _Thread_local
+#endif
+
+//output is formatted into a buffer of the thread and written with one write when it is full,
+//at exit and on flush(),stdout stays line buffered on a terminal as with printf
+//the buffer has external linkage,the copies of these functions the runtime bitcode links into
+//every module and the ones of libhelang_rt.a share it
+#define HE_OUTPUT_SIZE 65536
+
+typedef struct HeOutput{
+    size_t len;
+    //0 before the first write,1 flushed after every print,2 flushed when full
+    int mode;
+    char data[HE_OUTPUT_SIZE];
+} HeOutput;
+
+HE_THREAD_LOCAL HeOutput __he_output;
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+void flush(){
+    HeOutput* out = &__he_output;
+    //what was printed with stdio before comes first
+    fflush(stdout);
+    const char* p = out->data;
+    size_t n = out->len;
+    while(n > 0){
+        int w = write(1, p, (unsigned int)n);
+        if(w < 0 && errno == EINTR) continue;
+        if(w <= 0) break;
+        p += w;
+        n -= w;
+    }
+    out->len = 0;
+}
+
+static void flush_at_exit(){
+    flush();
+}
+
+//room for n bytes at the end of the buffer,n is at most HE_OUTPUT_SIZE
+static char* out_reserve(size_t n){
+    HeOutput* out = &__he_output;
+    if(out->mode == 0){
+        out->mode = isatty(1) ? 1 : 2;
+        atexit(flush_at_exit);
+    }
+    if(HE_OUTPUT_SIZE - out->len < n){
+        flush();
+    }
+    return out->data + out->len;
+}
+
+static void out_commit(char* end){
+    HeOutput* out = &__he_output;
+    out->len = end - out->data;
+}
+
+//the end of a print,a terminal sees every line at once
+static void out_done(){
+    if(__he_output.mode == 1){
+        flush();
+    }
+}
+
+static char* out_str(char* p, const char* s, size_t n){
+    memcpy(p, s, n);
+    return p + n;
+}
+
+//decimal digits of v,two at a time from the table
+static char* out_u32(char* p, uint32_t v){
+    char b[10];
+    char* s = b + sizeof(b);
+    while(v >= 100){
+        uint32_t r = v % 100;
+        v /= 100;
+        s -= 2;
+        memcpy(s, digit_pairs + r * 2, 2);
+    }
+    if(v >= 10){
+        s -= 2;
+        memcpy(s, digit_pairs + v * 2, 2);
+    }else{
+        *--s = (char)('0' + v);
+    }
+    return out_str(p, s, b + sizeof(b) - s);
+}
+
+static char* out_i32(char* p, int32_t v){
+    if(v < 0){
+        *p++ = '-';
+        return out_u32(p, 0u - (uint32_t)v);
+    }
+    return out_u32(p, (uint32_t)v);
+}
+
+#define SAINT "saint he says: "
+
+//the longest line is "saint he says: -2147483648!\n"
+static char* out_saint(char* p, int32_t n){
+    p = out_str(p, SAINT, sizeof(SAINT) - 1);
+    p = out_i32(p, n);
+    return out_str(p, "!\n", 2);
+}
 
 void print_i32(int n){
-    printf("saint he says: %d!\n",n);
+    out_commit(out_saint(out_reserve(32), n));
+    out_done();
 }
 
-void print_u8(uint64_t n){
-    int a[8],h = -1;
-    for(int b = 0;b < 8;b++){
+//the same lines as print_i32 for count values,for the c side of a program and embedders,helang
+//has no arrays to pass
+void print_i32_n(const int32_t* values, int64_t count){
+    for(int64_t i = 0; i < count; i++){
+        out_commit(out_saint(out_reserve(32), values[i]));
+    }
+    out_done();
+}
+
+//the highest nonzero byte and the ones below it,a value of 0 prints a single 0
+static int split_bytes(uint64_t n, int a[8]){
+    int h = -1;
+    for(int b = 0; b < 8; b++){
         int offset = (7 - b) * 8;
-        a[b] = (n & (0xffll << offset) ) >> offset;
+        a[b] = (n >> offset) & 0xff;
         if(a[b] != 0 && h < 0){
             h = b;
         }
     }
-    for(int i = h;i < 8;i++){
-        if(i == h){
-            printf("saint he says:u8 %d",a[i]);
+    return h < 0 ? 7 : h;
+}
+
+void print_u8(uint64_t n){
+    int a[8];
+    int h = split_bytes(n, a);
+    //"saint he says:u8 " and 8 bytes of at most 3 digits with their separators
+    char* p = out_reserve(64);
+    p = out_str(p, "saint he says:u8 ", 17);
+    p = out_u32(p, a[h]);
+    for(int i = h + 1; i < 8; i++){
+        *p++ = '|';
+        p = out_u32(p, a[i]);
+    }
+    *p++ = '\n';
+    out_commit(p);
+    out_done();
+}
+
+
+void test_5g(){
+    const char* msg = "Blocked by America.Please buy HuaWei to enable 5g\n";
+    out_commit(out_str(out_reserve(strlen(msg)), msg, strlen(msg)));
+    out_done();
+}
+
+//input is read in blocks of HE_INPUT_SIZE from stdin or the file HELANG_INPUT names and the
+//numbers are parsed from the block,a terminal gives a line per read so nothing waits for a
+//whole block
+#define HE_INPUT_SIZE 65536
+//zeros after the bytes read,a number is parsed 8 bytes at a time and stops at them
+#define HE_INPUT_PAD 8
+
+typedef struct HeInput{
+    size_t pos;
+    size_t len;
+    int fd;
+    //0 before the first read,1 prompts are printed,2 the input isn't a terminal and they aren't
+    int mode;
+    int eof;
+    char data[HE_INPUT_SIZE + HE_INPUT_PAD];
+} HeInput;
+
+HeInput __he_input;
+
+static const uint32_t pow10_u32[9] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+
+static void in_open(){
+    HeInput* in = &__he_input;
+    const char* path = getenv("HELANG_INPUT");
+    in->fd = 0;
+    if(path != NULL && (in->fd = open(path, O_RDONLY | O_BINARY)) < 0){
+        fprintf(stderr, "helang: fail to open the input %s\n", path);
+        in->eof = 1;
+    }
+    in->mode = in->fd >= 0 && isatty(in->fd) ? 1 : 2;
+}
+
+//read the next block once every byte of the last one is parsed,returns 0 at the end of the input
+static int in_fill(){
+    HeInput* in = &__he_input;
+    in->pos = 0;
+    in->len = 0;
+    int n = 0;
+    if(!in->eof){
+        while((n = read(in->fd, in->data, HE_INPUT_SIZE)) < 0 && errno == EINTR);
+        if(n > 0){
+            in->len = n;
         }else{
-            printf("|%d",a[i]);
+            in->eof = 1;
         }
     }
-    printf("\n");
+    memset(in->data + in->len, 0, HE_INPUT_PAD);
+    return n > 0;
 }
 
+static int ctz64(uint64_t x){
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (int)i;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
 
-void test_5g(){
-    const char* msg = "Blocked by America.Please buy HuaWei to enable 5g";
-    printf("%s\n",msg);
+//the count and value of the decimal digits at the start of 8 bytes,the bytes are checked and
+//combined as one 64 bit word instead of a branch per digit
+static int digits8(const char* p, uint32_t* value){
+    uint64_t x;
+    memcpy(&x, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    x = __builtin_bswap64(x);
+#endif
+    //a digit byte becomes 0-9,the first byte with a high nibble left in a or a+6 isn't a digit,
+    //a carry out of it only reaches the bytes after it
+    uint64_t a = x ^ 0x3030303030303030ull;
+    uint64_t nondigit = (a | (a + 0x0606060606060606ull)) & 0xf0f0f0f0f0f0f0f0ull;
+    int n = nondigit == 0 ? 8 : ctz64(nondigit) / 8;
+    *value = 0;
+    if(n == 0){
+        return 0;
+    }
+    //the n digits move to the top as if the number had leading zeros,then pairs,quads and
+    //octets of digits are combined
+    a <<= 8 * (8 - n);
+    a = (a * 10 + (a >> 8)) & 0x00ff00ff00ff00ffull;
+    a = (a * 100 + (a >> 16)) & 0x0000ffff0000ffffull;
+    a = (a * 10000 + (a >> 32)) & 0xffffffffull;
+    *value = (uint32_t)a;
+    return n;
+}
+
+//the next number of the input,bytes before it other than digits and signs are skipped,returns 0
+//at the end of the input,a value past i32 wraps
+static int in_i32(int32_t* value){
+    HeInput* in = &__he_input;
+    for(;;){
+        char c;
+        for(;;){
+            if(in->pos == in->len && !in_fill()){
+                return 0;
+            }
+            c = in->data[in->pos];
+            if((unsigned char)(c - '0') < 10 || c == '-' || c == '+'){
+                break;
+            }
+            in->pos++;
+        }
+        int negative = c == '-';
+        in->pos += c == '-' || c == '+';
+
+        uint32_t v = 0;
+        int digits = 0;
+        for(;;){
+            //a number can go on in the next block
+            if(in->pos == in->len && !in_fill()){
+                break;
+            }
+            uint32_t d;
+            int n = digits8(in->data + in->pos, &d);
+            v = v * pow10_u32[n] + d;
+            in->pos += n;
+            digits += n;
+            if(n < 8 && in->pos < in->len){
+                break;
+            }
+        }
+        //a sign without a digit after it,as the - of "1 - 2",is skipped like any other byte
+        if(digits > 0){
+            *value = negative ? (int32_t)(0u - v) : (int32_t)v;
+            return 1;
+        }
+    }
 }
 
 int input_i32(){
-    int num;
-    printf("input a i32 number:");
-    scanf("%d",&num);
+    HeInput* in = &__he_input;
+    if(in->mode == 0){
+        in_open();
+    }
+    if(in->mode == 1){
+        const char* prompt = "input a i32 number:";
+        out_commit(out_str(out_reserve(strlen(prompt)), prompt, strlen(prompt)));
+        //the prompt is seen before the input is waited for
+        flush();
+    }
+    int32_t num = 0;
+    in_i32(&num);
     return num;
 }
 
-void powerCon(uint64_t na,int force){
-    int a[8],h = -1;
-    for(int b = 0;b < 8;b++){
-        int offset = (7 - b) * 8;
-        a[b] = (na & (0xffll << offset) ) >> offset;
-        if(a[b] != 0 && h < 0){
-            h = b;
-        }
+//read up to count numbers without prompts,returns how many there were before the end of the input
+int64_t input_i32_n(int32_t* values, int64_t count){
+    HeInput* in = &__he_input;
+    if(in->mode == 0){
+        in_open();
+    }
+    if(in->mode == 1){
+        flush();
     }
+    int64_t i = 0;
+    while(i < count && in_i32(values + i)){
+        i++;
+    }
+    return i;
+}
+
+void powerCon(uint64_t na,int force){
+    int a[8];
+    int h = split_bytes(na, a);
 
     static int keyboard[68] = {0};
     for(int i = h;i < 8;i++){
-        keyboard[a[i]] = force;
+        if(a[i] < 68) keyboard[a[i]] = force;
     }
-    
-    printf("keyboard powers : [%d",keyboard[0]);
+
+    //"keyboard powers : [" and 26 counts of at most 11 characters with their separators
+    char* p = out_reserve(19 + 26 * 12 + 2);
+    p = out_str(p, "keyboard powers : [", 19);
+    p = out_i32(p, keyboard[0]);
     for(int i = 1;i < 26;i++){
-        printf(",%d",keyboard[i]);
+        *p++ = ',';
+        p = out_i32(p, keyboard[i]);
     }
-    printf("]\n");
-}
\ No newline at end of file
+    p = out_str(p, "]\n", 2);
+    out_commit(p);
+    out_done();
+}
@@ -1,7 +1,62 @@
+#define _CRT_SECURE_NO_WARNINGS
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 extern int __he_entry_main();
+extern void flush();
+
+//counters of a module compiled with --profile-generate
+typedef struct HeProfile{
+    const char* layout;
+    uint64_t* counters;
+    struct HeProfile* next;
+} HeProfile;
+
+static HeProfile* profiles = NULL;
+
+//write the counters of every module to HELANG_PROFILE(default.heprof),see src/lib/profile.cpp
+static void write_profile(){
+    const char* path = getenv("HELANG_PROFILE");
+    FILE* f = fopen(path != NULL ? path : "default.heprof", "w");
+    if(f == NULL){
+        return;
+    }
+    fprintf(f, "helang-profile 1\n");
+    for(HeProfile* p = profiles; p != NULL; p = p->next){
+        const char* line = p->layout;
+        uint64_t* c = p->counters;
+        char key[1024];
+        unsigned int n;
+        int len;
+        while(sscanf(line, "%1023s %u\n%n", key, &n, &len) == 2){
+            fprintf(f, "%s %u", key, n);
+            for(unsigned int i = 0; i < n; i++){
+                fprintf(f, " %llu", (unsigned long long)c[i]);
+            }
+            fprintf(f, "\n");
+            c += n;
+            line += len;
+        }
+    }
+    fclose(f);
+}
+
+//called by the constructor of every instrumented module
+void __he_profile_register(const char* layout, uint64_t* counters){
+    HeProfile* p = (HeProfile*)malloc(sizeof(HeProfile));
+    if(profiles == NULL){
+        atexit(write_profile);
+    }
+    p->layout = layout;
+    p->counters = counters;
+    p->next = profiles;
+    profiles = p;
+}
 
 int main(){
     int num = __he_entry_main();
+    //the output of the program comes before the line of main
+    flush();
     printf("so cool!helang exits and returns %d",num);
-}
\ No newline at end of file
+}